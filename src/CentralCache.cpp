@@ -2,61 +2,43 @@
 #include "PageCache.h"
 
 // 从CentralCache获取一批对象
-size_t CentralCache::FetchRangeObj(void*& start, void*& end, size_t size, int num) {
+size_t CentralCache::FetchRangeObj(void*& start, void*& end, size_t size, int num, size_t node) {
     size_t index = SizeClass::Index(size);
     
     // 加锁保护
-    _mtx[index].mtx.lock();
+    Lock(node, index);
     
-    // 1. 先从对应的SpanList中找有空闲对象的Span
-    Span* span = _spanLists[index].Begin();
-    while (span != _spanLists[index].End()) {
-        if (span->_freeList != nullptr) {
-            break;  // 找到有空闲对象的Span
-        }
-        span = span->_next;
-    }
+    // 1. 先从分桶的SpanList中找有空闲对象的Span（满Span不在这些链表里，不用扫描）
+    Span* span = GetNonemptySpan(node, index);
     
     // 2. 如果没找到，向PageCache申请新的Span
-    if (span == _spanLists[index].End()) {
-        _mtx[index].mtx.unlock();  // 先解锁，避免死锁
+    if (span == nullptr) {
+        Unlock(node, index);  // 先解锁，避免死锁
         
-        // 向PageCache申请Span
-        size_t numPages = SizeClass::NumMovePage(size);
-        span = PageCache::GetInstance()->NewSpan(numPages);
+        // 向PageCache申请Span，每个桶固定对应本节点的一个PageCache分片，不同size class的申请分散到不同的锁上
+        size_t numPages = SizeClass::ClassPages(index);
+        span = PageCache::GetInstance()->NewSpan(numPages, node * PAGE_CACHE_SHARDS + index % PAGE_CACHE_SHARDS);
         
-        // 切分Span成小块对象
+        // 不再一次性把整个Span切成链表（要写每一块、把整个Span的页都碰一遍），
+        // 只记录没切分的区域，取对象时按需切，用多少切多少
         size_t spanBytes = span->_n << PAGE_SHIFT;  // Span总字节数（页数 * 8KB）
         size_t blockCount = spanBytes / size;  // 能切多少块
-        void* spanStart = (void*)((span->_pageId) << PAGE_SHIFT);  // Span起始地址
+        char* spanStart = (char*)((span->_pageId) << PAGE_SHIFT);  // Span起始地址
         
-        // 串成链表：前blockCount-1块
-        for (size_t i = 0; i < blockCount - 1; ++i) {
-            void* cur = (void*)((char*)spanStart + i * size);
-            void* next = (void*)((char*)spanStart + (i + 1) * size);
-            NextObj(cur) = next;
-        }
-        // 最后一块指向nullptr
-        void* last = (void*)((char*)spanStart + (blockCount - 1) * size);
-        NextObj(last) = nullptr;
-        
-        span->_freeList = spanStart;  // 链表头
+        span->_freeList = nullptr;     // 还没有释放过的对象
+        span->_bumpPtr = spanStart;
+        span->_bumpEnd = spanStart + blockCount * size;
         span->_objSize = size;         // 记录对象大小
-        span->_isUse = true;
+        span->_objCount = blockCount;  // 记录对象总数
         
-        _mtx[index].mtx.lock();  // 重新加锁
-        _spanLists[index].PushFront(span);  // 挂到SpanList
-        // _pageToSpan[span->_pageId] = span;  // 建立页号→Span映射
-        //这里只映射了首页地址，若Span管理多页，后面页没有建立映射，如果返回对象来自后面页，这会造成ThreadCache无法找到Span，导致内存泄露
-        //正确做法：
-        //建立每一页的映射（用于释放时根据对象地址查找Span）
-        for(PAGE_ID  i = 0 ; i< span->_n;++i)
-        {
-            _pageToSpan[span->_pageId+i] = span;
-        }
+        Lock(node, index);  // 重新加锁
+        _stats[node][index].freeObjects.Add(blockCount);
+        _stats[node][index].spans.Add(1);
+        // 先不挂链表，下面取完对象由RefileSpan按占用率挂上去
+        // 页号→Span的映射由PageCache::NewSpan统一建立（每一页都映射），这里不再维护
     }
     
-    // 3. 从Span的freeList中取出num个对象
+    // 3. 先从Span的freeList中取还回来的对象
     void* cur = span->_freeList;
     void* prev = nullptr;
     size_t actualNum = 0;
@@ -66,16 +48,33 @@ size_t CentralCache::FetchRangeObj(void*& start, void*& end, size_t size, int nu
         cur = NextObj(cur);
         ++actualNum;
     }
-    
-    // 更新返回值
     start = span->_freeList;
-    end = prev;
-    
-    // 更新Span的freeList
     span->_freeList = cur;
+    
+    // 4. 不够再从没切分的区域切，新切的对象接在后面
+    while (actualNum < (size_t)num && span->_bumpPtr < span->_bumpEnd) {
+        void* obj = span->_bumpPtr;
+        span->_bumpPtr += size;
+        if (prev == nullptr) {
+            start = obj;
+        }
+        else {
+            NextObj(prev) = obj;
+        }
+        prev = obj;
+        ++actualNum;
+    }
+    
+    // 更新返回值，断开链表
+    end = prev;
+    NextObj(end) = nullptr;
     span->_useCount += actualNum;
+    _stats[node][index].freeObjects.Sub(actualNum);
     
-    _mtx[index].mtx.unlock();
+    // 占用率变了，挂到新的桶（或者满链表）
+    RefileSpan(node, index, span);
+    
+    Unlock(node, index);
     
     return actualNum;
 }
@@ -84,51 +83,95 @@ size_t CentralCache::FetchRangeObj(void*& start, void*& end, size_t size, int nu
 void CentralCache::ReleaseListToSpans(void* start, size_t size) {
     size_t index = SizeClass::Index(size);
     
-
-    _mtx[index].mtx.lock();  // 加锁保护
+    // 一般整条链表都属于同一个节点，只有遇到别的节点的对象才换锁
+    size_t node = PageCache::NodeOf(PageCache::GetInstance()->MapObjectToSpan(start));
+    Lock(node, index);  // 加锁保护
     
     // 遍历要释放的对象链表
     while (start != nullptr) {
         void* next = NextObj(start);  // 先保存下一个节点
         
         // 1. 根据地址计算页号，找到对应的Span
-        PAGE_ID pageId = ((PAGE_ID)start) >> PAGE_SHIFT;
-        Span* span = _pageToSpan[pageId];
+        // 查页表不需要加锁，PageCache分配Span时已经建立好映射
+        Span* span = PageCache::GetInstance()->MapObjectToSpan(start);
+        assert(span);
+        if (PageCache::NodeOf(span) != node) {
+            Unlock(node, index);
+            node = PageCache::NodeOf(span);
+            Lock(node, index);
+        }
+        
+        // 2. 记下还回之前所在的链表（满链表或者某个桶）
+        bool wasFull = !HasFreeObject(span);
+        size_t oldBucket = wasFull ? 0 : OccupancyBucket(span);
         
-        // 2. 把对象还回Span的freeList（头插法）
+        // 3. 把对象还回Span的freeList（头插法），更新使用计数
         NextObj(start) = span->_freeList;
         span->_freeList = start;
-        
-        // 3. 更新使用计数
         span->_useCount--;
+        _stats[node][index].freeObjects.Add(1);
         
         // 4. 如果Span的所有对象都释放了，归还给PageCache
         if (span->_useCount == 0) {
+            _stats[node][index].freeObjects.Sub(span->_objCount);
+            _stats[node][index].spans.Sub(1);
             // 4.1 从SpanList中摘除
-            _spanLists[index].Erase(span);
-            
-            // 4.2 删除CentralCache的映射（每一页都要删除）
-            for (PAGE_ID i = 0; i < span->_n; ++i) {
-                _pageToSpan.erase(span->_pageId + i);
+            if (wasFull) {
+                _fullLists[node][index].Erase(span);
+            }
+            else {
+                _nonemptyLists[node][index][oldBucket].Erase(span);
             }
             
-            // 4.3 设置为未使用状态
-            span->_isUse = false;
+            // 4.2 映射和_isUse状态都交给PageCache在锁内处理
             
-            // 4.4 先解锁，避免与PageCache的锁形成死锁
-            _mtx[index].mtx.unlock();
+            // 4.3 先解锁，避免与PageCache的锁形成死锁
+            Unlock(node, index);
             
-            // 4.5 归还给PageCache（PageCache会进行页合并）
+            // 4.4 归还给PageCache（PageCache会进行页合并）
             PageCache::GetInstance()->ReleaseSpanToPageCache(span);
             
-            // 4.6 重新加锁，因为while循环还要继续
-            _mtx[index].mtx.lock();
+            // 4.5 重新加锁，因为while循环还要继续
+            Lock(node, index);
+        }
+        else if (wasFull || OccupancyBucket(span) != oldBucket) {
+            // 4.6 从满链表移出，或者占用率跨了桶，换到对应的链表
+            if (wasFull) {
+                _fullLists[node][index].Erase(span);
+            }
+            else {
+                _nonemptyLists[node][index][oldBucket].Erase(span);
+            }
+            RefileSpan(node, index, span);
         }
         
         // 5. 移动到下一个对象
         start = next;
     }
     
-    _mtx[index].mtx.unlock();
+    Unlock(node, index);
 }
 
+
+// 按当前状态把Span挂到满链表或者对应占用率的桶（调用前Span不在任何链表里）
+void CentralCache::RefileSpan(size_t node, size_t index, Span* span) {
+    if (!HasFreeObject(span)) {
+        _fullLists[node][index].PushFront(span);
+    }
+    else {
+        _nonemptyLists[node][index][OccupancyBucket(span)].PushFront(span);
+    }
+}
+
+// 从占用率最高的桶往下找，桶数是常数，取对象是O(1)
+Span* CentralCache::GetNonemptySpan(size_t node, size_t index) {
+    for (size_t b = CENTRAL_OCCUPANCY_BUCKETS; b > 0; --b) {
+        SpanList& list = _nonemptyLists[node][index][b - 1];
+        if (!list.Empty()) {
+            Span* span = list.Begin();
+            list.Erase(span);  // 先摘下来，取完对象由RefileSpan重新挂
+            return span;
+        }
+    }
+    return nullptr;
+}
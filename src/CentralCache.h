@@ -2,17 +2,21 @@
 #define __CENTRAL_CACHE_H__
 
 #include "Common.h"
-#include <unordered_map>
+#include "Numa.h"
+#include "LockProfile.h"
 #include <mutex>
 
-//优化点1，对齐到缓存行，避免伪共享
+// 有空闲对象的Span按占用率（_useCount/_objCount）分成几个桶，取对象时优先用最满的桶
+static const size_t CENTRAL_OCCUPANCY_BUCKETS = 8;
+
+//优化点1，对齐到缓存行，避免伪共享（alignas(64)让大小向上取整到64的倍数，开启ENABLE_LOCK_PROFILE时锁本身超过一个缓存行）
 struct alignas(64) PaddedMutex {
-    std::mutex mtx;
-    char padding[64 - sizeof(std::mutex)];
+    CacheMutex mtx;
 };
 
 // 中心缓存 - 单例模式
 // 负责从PageCache获取Span，切分成小对象供ThreadCache使用
+// 开启ENABLE_NUMA时每个NUMA节点各有一套桶（链表和锁），Span挂在它所在节点的桶里
 class CentralCache {
 public:
     // 获取单例对象
@@ -26,22 +30,93 @@ public:
     // end: 返回获取对象链表的结束指针
     // size: 对象大小
     // num: 期望获取的对象数量
+    // node: 从哪个NUMA节点的Span取（没有开启ENABLE_NUMA时只有节点0）
     // 返回值: 实际获取到的对象数量
-    size_t FetchRangeObj(void*& start, void*& end, size_t size, int num);
+    size_t FetchRangeObj(void*& start, void*& end, size_t size, int num, size_t node = 0);
     
-    // 将一定数量的对象释放回Span
+    // 将一定数量的对象释放回Span，链表里的对象可以属于不同节点，各自还回所在节点的桶
     // start: 要释放的对象链表头
     // size: 对象大小
     void ReleaseListToSpans(void* start, size_t size);
 
+    // 某个size class（所有节点合计）Span里还没分配出去的对象数（包括还没切分的区域）和Span数，汇总统计用
+    uint64_t GetFreeObjects(size_t index) const {
+        uint64_t num = 0;
+        for (size_t node = 0; node < NUMA_MAX_NODES; ++node) {
+            num += _stats[node][index].freeObjects.Load();
+        }
+        return num;
+    }
+    uint64_t GetSpanCount(size_t index) const {
+        uint64_t num = 0;
+        for (size_t node = 0; node < NUMA_MAX_NODES; ++node) {
+            num += _stats[node][index].spans.Load();
+        }
+        return num;
+    }
+
+    // fork前按节点、size class的顺序拿住所有桶锁，fork后在父子进程里各自释放（见MallocOverride.cpp）
+    void LockAll() {
+        for (size_t node = 0; node < NUMA_MAX_NODES; ++node) {
+            for (size_t index = 0; index < NFREELIST; ++index) {
+                Lock(node, index);
+            }
+        }
+    }
+    void UnlockAll() {
+        for (size_t node = 0; node < NUMA_MAX_NODES; ++node) {
+            for (size_t index = 0; index < NFREELIST; ++index) {
+                Unlock(node, index);
+            }
+        }
+    }
+
+#ifdef ENABLE_LOCK_PROFILE
+    // 某个节点某个size class的桶锁的竞争统计
+    const LockCounters& GetLockCounters(size_t node, size_t index) const { return _mtx[node][index].mtx.Counters(); }
+#endif
+
 private:
     CentralCache() {}  // 构造函数私有化
     CentralCache(const CentralCache&) = delete;  // 禁止拷贝构造
     CentralCache& operator=(const CentralCache&) = delete;  // 禁止赋值
     
-    SpanList _spanLists[208];  // 按对象大小映射的Span双向链表数组
-    std::unordered_map<PAGE_ID, Span*> _pageToSpan;  // 页号到Span的映射
-    PaddedMutex _mtx[208];  // 全局锁，保护CentralCache的并发访问,细粒度化改进
+    // 桶锁加解锁（开启ENABLE_LOCK_PROFILE时每把锁自己统计次数和时间，见LockProfile.h）
+    void Lock(size_t node, size_t index) {
+        _mtx[node][index].mtx.lock();
+    }
+    void Unlock(size_t node, size_t index) {
+        _mtx[node][index].mtx.unlock();
+    }
+    
+    // Span里还有没有能分配的对象：自由链表里有，或者还有没切分的区域
+    static bool HasFreeObject(Span* span) {
+        return span->_freeList != nullptr || span->_bumpPtr < span->_bumpEnd;
+    }
+    
+    // 按占用率取桶号，只对还有空闲对象的Span有意义（_useCount < _objCount）
+    static size_t OccupancyBucket(Span* span) {
+        return span->_useCount * CENTRAL_OCCUPANCY_BUCKETS / span->_objCount;
+    }
+    
+    // Span的对象被取走/还回之后，挂到对应的链表：没有空闲对象进满链表，否则按占用率进桶
+    void RefileSpan(size_t node, size_t index, Span* span);
+    
+    // 从最满的非空桶里找一个有空闲对象的Span，没有返回nullptr
+    Span* GetNonemptySpan(size_t node, size_t index);
+    
+    // 每个size class的Span分成两类，取对象时不再线性扫描满Span：
+    // 有空闲对象的按占用率分桶（越满越优先，几乎空的Span没人用，就能尽快全部还回来归还PageCache），
+    // 对象全部分配出去的单独挂在满链表里，只在有对象还回来时才移出
+    SpanList _nonemptyLists[NUMA_MAX_NODES][208][CENTRAL_OCCUPANCY_BUCKETS];
+    SpanList _fullLists[NUMA_MAX_NODES][208];
+    PaddedMutex _mtx[NUMA_MAX_NODES][208];  // 全局锁，保护CentralCache的并发访问,细粒度化改进
+    // 每个桶的统计，在桶锁内更新，读的时候不加锁；各占一个缓存行，不同桶的线程互不干扰
+    struct alignas(64) BucketStats {
+        StatCounter freeObjects;  // Span里还没分配出去的对象数
+        StatCounter spans;        // 从PageCache拿来、还没还回去的Span数
+    };
+    BucketStats _stats[NUMA_MAX_NODES][208];
 };
 
 #endif
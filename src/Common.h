@@ -5,6 +5,10 @@
 #include <mutex>
 #include <assert.h>
 #include <algorithm>
+#include <new>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -23,8 +27,71 @@ static const size_t NFREELIST = 208;          // 自由链表数组长度
 static const size_t NPAGES = 129;             // PageCache最多管理128页
 static const size_t PAGE_SHIFT = 13;          // 页大小8KB (2^13)
 
+// 超过128页的大内存Span也由PageCache缓存、合并，只有超过这个页数的才直接mmap/munmap
+// 编译时添加 -DDIRECT_MMAP_PAGES=页数 调整，默认4096页（32MB）
+#ifndef DIRECT_MMAP_PAGES
+#define DIRECT_MMAP_PAGES 4096
+#endif
+static_assert(DIRECT_MMAP_PAGES >= NPAGES - 1, "直接mmap的阈值不能小于128页");
+
 static constexpr size_t GROUP_ARRAY[4] = {16, 56, 56, 56};//优化编译器计算，提取全局变量
-// 向操作系统申请内存
+
+// 大页开关：通过编译选项控制
+// 编译时添加 -DENABLE_HUGEPAGE 开启，PageCache每次向系统申请2MB并用大页映射，减少TLB miss
+// 不添加则按128页（1MB）普通页申请
+#ifdef ENABLE_HUGEPAGE
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;                  // 2MB大页
+static const size_t SYSTEM_REFILL_PAGES = HUGE_PAGE_SIZE >> PAGE_SHIFT;  // 一次申请256页
+#else
+static const size_t SYSTEM_REFILL_PAGES = NPAGES - 1;                   // 一次申请128页
+#endif
+static_assert(SYSTEM_REFILL_PAGES % (NPAGES - 1) == 0, "一次申请的页数必须是128页的整数倍");
+
+// 统计最低位的1后面有几个0（x不能为0），编译成一条tzcnt/bsf指令
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+static inline size_t CountTrailingZeros(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// 禁止/强制内联，MSVC和GCC/Clang写法不同
+#if defined(_MSC_VER)
+    #define POOL_NOINLINE __declspec(noinline)
+    #define POOL_ALWAYS_INLINE __forceinline
+#else
+    #define POOL_NOINLINE __attribute__((noinline))
+    #define POOL_ALWAYS_INLINE __attribute__((always_inline)) inline
+#endif
+
+#ifndef _WIN32
+// mmap只保证4KB对齐，而页号按8KB（或2MB大页）计算，需要多申请align字节再把首尾多余部分还回去
+inline static void* SystemMmapAligned(size_t bytes, size_t align) {
+    size_t mapBytes = bytes + align;
+    void* raw = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+
+    uintptr_t start = (uintptr_t)raw;
+    uintptr_t aligned = (start + align - 1) & ~(uintptr_t)(align - 1);
+    size_t head = aligned - start;                 // 头部多出来的部分
+    size_t tail = mapBytes - head - bytes;         // 尾部多出来的部分
+    if (head > 0)
+        munmap(raw, head);
+    if (tail > 0)
+        munmap((void*)(aligned + bytes), tail);
+    return (void*)aligned;
+}
+#endif
+
+// 向操作系统申请内存（kpage页，起始地址按页对齐，保证页号计算正确）
 inline static void* SystemAlloc(size_t kpage) {
     void* ptr = nullptr;
     
@@ -33,7 +100,28 @@ inline static void* SystemAlloc(size_t kpage) {
                        MEM_COMMIT | MEM_RESERVE, 
                        PAGE_READWRITE);
 #else
-    // Linux版本后面再说
+    size_t bytes = kpage << PAGE_SHIFT;
+#ifdef ENABLE_HUGEPAGE
+    // 1.整数倍2MB的申请优先用预留的大页（hugetlbfs），内核保证2MB对齐
+    if (bytes % HUGE_PAGE_SIZE == 0) {
+#ifdef MAP_HUGETLB
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED)
+            ptr = nullptr;
+#endif
+        // 2.没有预留大页时退化为透明大页：按2MB对齐映射，再madvise建议内核用大页
+        if (ptr == nullptr) {
+            ptr = SystemMmapAligned(bytes, HUGE_PAGE_SIZE);
+#ifdef MADV_HUGEPAGE
+            if (ptr != nullptr)
+                madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+        }
+    }
+#endif
+    if (ptr == nullptr)
+        ptr = SystemMmapAligned(bytes, (size_t)1 << PAGE_SHIFT);
 #endif
 
     if (ptr == nullptr)
@@ -42,17 +130,48 @@ inline static void* SystemAlloc(size_t kpage) {
     return ptr;
 }
 
-// 向操作系统释放内存  
-inline static void SystemFree(void* ptr) {
+// 把一段空闲内存的物理页还给操作系统，但保留地址空间，之后再访问时按需重新缺页
+// 编译时添加 -DUSE_MADV_FREE 改用MADV_FREE（内核在内存紧张时才真正回收，RSS不会立刻下降）
+// 返回false表示没有还成功（例如hugetlbfs大页不能按8KB粒度还）
+inline static bool SystemRelease(void* ptr, size_t kpage) {
+#ifdef _WIN32
+    return VirtualAlloc(ptr, kpage << PAGE_SHIFT, MEM_RESET, PAGE_READWRITE) != nullptr;
+#elif defined(USE_MADV_FREE) && defined(MADV_FREE)
+    return madvise(ptr, kpage << PAGE_SHIFT, MADV_FREE) == 0;
+#else
+    return madvise(ptr, kpage << PAGE_SHIFT, MADV_DONTNEED) == 0;
+#endif
+}
+
+// 向操作系统释放内存（kpage必须和SystemAlloc时一致，munmap需要长度）
+inline static void SystemFree(void* ptr, size_t kpage) {
 #ifdef _WIN32
     VirtualFree(ptr, 0, MEM_RELEASE);
 #else
-    // Linux版本后面再说  
+    munmap(ptr, kpage << PAGE_SHIFT);
 #endif
 }
 
 
 
+// 统计锁持有/等待时间用的时钟（纳秒）
+static inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 统计计数器：同一时刻只有一个线程写（所属线程，或者持有对应锁的线程），别的线程只在汇总时读
+// 写用relaxed的load+store而不是fetch_add，编译出来就是普通的读写指令，没有lock前缀，也不和别的线程抢缓存行
+class StatCounter {
+public:
+    void Add(uint64_t n) { _value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void Sub(uint64_t n) { _value.store(_value.load(std::memory_order_relaxed) - n, std::memory_order_relaxed); }
+    uint64_t Load() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> _value{0};
+};
+
 //获取/设置对象的下一个节点
 static inline void*& NextObj(void* obj)//这个函数可以获取下一个节点，还可以设置下一个节点
 {
@@ -84,6 +203,21 @@ class FreeList {
         {
             return _size;
         };           // 长度
+        size_t& MaxSize()
+        {
+            return _maxSize;
+        };           // 慢启动的长度上限（每次向CentralCache申请的个数也不超过它）
+        size_t& Overages()
+        {
+            return _overages;
+        };           // 超过上限触发归还的次数
+        void PushRange(void* start, void* end, size_t n)//把一串已经连好的对象整段头插，O(1)
+        {
+            assert(start && end);
+            NextObj(end) = _freeList;
+            _freeList = start;
+            _size += n;
+        }
         void PopRange(void*& start, void*& end, size_t n)
         {
             assert(n <= _size);
@@ -110,6 +244,8 @@ class FreeList {
     private:
         void* _freeList = nullptr;  // 链表头指针
         size_t _size = 0;           // 当前长度
+        size_t _maxSize = 1;        // 慢启动：从1开始，每次向CentralCache申请时增长
+        size_t _overages = 0;       // 连续超长次数，超过一定次数就收缩_maxSize
     };
 
 class SizeClass {//内存对齐+索引计算
@@ -120,9 +256,8 @@ class SizeClass {//内存对齐+索引计算
             return ((bytes + alignNum - 1) & ~(alignNum - 1));//核心掩码对齐算法
         }
         
-        // 主函数：根据大小选择对齐数
-        static inline size_t RoundUp(size_t bytes) {
-            // TODO: 根据size范围，调用_RoundUp
+        // 按范围分段计算对齐后的大小（分支多，只用来在编译期生成查找表，运行时用RoundUp查表）
+        static inline constexpr size_t CalcRoundUp(size_t bytes) {
             if (bytes <= 128) {
                 return _RoundUp(bytes, 8);      // ← 用8对齐
             }
@@ -149,8 +284,8 @@ class SizeClass {//内存对齐+索引计算
             return ((bytes + (1 << align_shift) - 1) >> align_shift) - 1;
         }
         
-        // 主函数：计算全局索引
-        static inline constexpr size_t Index(size_t bytes) {
+        // 按范围分段计算全局索引（同上，只用来生成查找表）
+        static inline constexpr size_t CalcIndex(size_t bytes) {
             // assert(bytes <= MAX_BYTES);//这一行也要去除，因为constexpr编译期计算，所以不需要再判断
             
             // // 每个范围占用的索引数量
@@ -177,6 +312,24 @@ class SizeClass {//内存对齐+索引计算
             return -1;
         }
         
+        // 主函数：根据大小选择对齐数，查表得到所在size class的对象大小，超过MAX_BYTES按页对齐
+        static inline constexpr size_t RoundUp(size_t bytes);
+        
+        // 主函数：计算全局索引，查表，不再逐段比较
+        static inline constexpr size_t Index(size_t bytes);
+        
+        // 反查：size class的对象大小、一次批量移动的对象个数、每个Span的页数
+        // 调用方只要有索引就够了，不用再一路传size
+        static inline constexpr size_t Size(size_t index);
+        static inline constexpr size_t BatchSize(size_t index);
+        static inline constexpr size_t ClassPages(size_t index);
+        
+        // 查找表的下标：1024字节以内按8字节一档，以上按128字节一档（TCMalloc的ClassIndex），
+        // 两段共用一个数组，小于等于1024的部分正好占前129项
+        static inline constexpr size_t LookupIndex(size_t bytes) {
+            return bytes <= 1024 ? (bytes + 7) >> 3 : (bytes + 127 + (120 << 7)) >> 7;
+        }
+        
         // 计算申请size大小的对象时，应该向PageCache申请几页
         static inline constexpr size_t NumMovePage(size_t size) {
             // 简单策略：size小于8KB申请1页，否则向上取整
@@ -210,6 +363,52 @@ class SizeClass {//内存对齐+索引计算
         }
     };
 
+// size class查找表：编译期按上面的分段规则生成，运行时Index/RoundUp只需查一次数组
+// 所有分段边界都是128的整数倍（1024以内是8的整数倍），同一档里的大小一定属于同一个size class
+struct SizeClassTable {
+    static constexpr size_t CLASS_ARRAY_SIZE = SizeClass::LookupIndex(MAX_BYTES) + 1;  // 2169项
+    
+    uint8_t classArray[CLASS_ARRAY_SIZE] = {};  // 查找表下标 -> size class索引
+    uint32_t classSize[NFREELIST] = {};         // size class索引 -> 对象大小
+    uint16_t batchSize[NFREELIST] = {};         // size class索引 -> NumMoveSize
+    uint16_t classPages[NFREELIST] = {};        // size class索引 -> NumMovePage
+    
+    constexpr SizeClassTable() {
+        for (size_t i = 0; i < CLASS_ARRAY_SIZE; ++i) {
+            // 这一档里最大的大小（size为0和1~8同一档）
+            size_t bytes = i <= 128 ? i << 3 : (i - 120) << 7;
+            if (bytes == 0) {
+                bytes = 1;
+            }
+            size_t index = SizeClass::CalcIndex(bytes);
+            size_t size = SizeClass::CalcRoundUp(bytes);
+            classArray[i] = (uint8_t)index;
+            classSize[index] = (uint32_t)size;
+            batchSize[index] = (uint16_t)SizeClass::NumMoveSize(size);
+            classPages[index] = (uint16_t)SizeClass::NumMovePage(size);
+        }
+    }
+};
+inline constexpr SizeClassTable SIZE_CLASS_TABLE{};
+static_assert(NFREELIST - 1 <= UINT8_MAX, "size class索引要能放进uint8_t");
+static_assert(SIZE_CLASS_TABLE.classSize[NFREELIST - 1] == MAX_BYTES, "最后一个size class必须是MAX_BYTES");
+
+inline constexpr size_t SizeClass::Index(size_t bytes) {
+    return SIZE_CLASS_TABLE.classArray[LookupIndex(bytes)];
+}
+inline constexpr size_t SizeClass::RoundUp(size_t bytes) {
+    return bytes <= MAX_BYTES ? SIZE_CLASS_TABLE.classSize[Index(bytes)] : _RoundUp(bytes, 1 << PAGE_SHIFT);
+}
+inline constexpr size_t SizeClass::Size(size_t index) {
+    return SIZE_CLASS_TABLE.classSize[index];
+}
+inline constexpr size_t SizeClass::BatchSize(size_t index) {
+    return SIZE_CLASS_TABLE.batchSize[index];
+}
+inline constexpr size_t SizeClass::ClassPages(size_t index) {
+    return SIZE_CLASS_TABLE.classPages[index];
+}
+
 // 页号类型定义
 #ifdef _WIN64
     typedef unsigned long long PAGE_ID;
@@ -217,6 +416,8 @@ class SizeClass {//内存对齐+索引计算
     typedef size_t PAGE_ID;
 #endif
 
+struct HeapSample;
+
 struct Span {
     PAGE_ID _pageId = 0;         // 起始页号
     size_t _n = 0;               // 页数
@@ -226,17 +427,29 @@ struct Span {
     
     size_t _objSize = 0;         // 切分的对象大小（8字节？16字节？）
     size_t _useCount = 0;        // 已分配出去的对象数量
-    void* _freeList = nullptr;   // 剩余对象的自由链表
+    size_t _objCount = 0;        // 切分出来的对象总数，CentralCache按占用率分桶用
+    void* _freeList = nullptr;   // 还回来的对象的自由链表（只放释放过的对象）
+    char* _bumpPtr = nullptr;    // 还没切分过的区域[_bumpPtr, _bumpEnd)，按需切分
+    char* _bumpEnd = nullptr;
     
     bool _isUse = false;         // 是否正在被CentralCache使用
+    bool _returned = false;      // 空闲期间物理内存已经还给系统（PageCache用）
+    uint64_t _freeTime = 0;      // 变成空闲的时间（毫秒），后台回收按空闲时长挑选
+    // 所属的PageCache分片，释放时还回这个分片。别的分片合并相邻Span时会不加这个分片的锁读它，所以是原子变量：
+    // 所属分片在发布到页表之前release写，读的一方acquire读，只有读到自己的分片号才继续读其他字段（那时受自己的锁保护）
+    // 不在构造时初始化：Span对象从对象池回收再构造时不写它，拿着旧页表项的其他分片读到的仍然是原来的分片号
+    std::atomic<uint32_t> _shard;
+    HeapSample* _sample = nullptr; // 不为空说明这个Span是一次被采样的分配（HeapProfiler），释放时删掉采样记录
 };
 class SpanList {
     public:
         SpanList() {
-            _head = new Span;           // 哨兵节点
+            _head = &_headNode;         // 哨兵节点直接内嵌在SpanList里，不需要从堆上申请
             _head->_next = _head;       // 循环链表
             _head->_prev = _head;
         }
+        SpanList(const SpanList&) = delete;             // 哨兵节点地址不能变，禁止拷贝
+        SpanList& operator=(const SpanList&) = delete;
         
         Span* Begin() { return _head->_next; }
         Span* End() { return _head; }
@@ -277,5 +490,6 @@ class SpanList {
         std::mutex _mtx;  // 这个锁后面用
     
     private:
+        Span _headNode;   // 哨兵节点本体
         Span* _head;      // 哨兵头节点
     };
\ No newline at end of file
@@ -1,20 +1,18 @@
 #pragma once
 #include <atomic>
+#include <string.h>
 #include "Common.h"
 #include "ThreadCache.h"
 #include "PageCache.h"
+#include "PerCpuCache.h"
+#include "PoolStats.h"
+#include "HeapProfiler.h"
 
-// 性能统计开关：通过编译选项控制
-// 编译时添加 -DENABLE_STATS 开启统计
-// 不添加则关闭统计，提升5-10%性能
-
-#ifdef ENABLE_STATS
-//性能统计初步指标，设计成原子变量，在高频调用且较为简单场景下性能优于锁
-std::atomic<size_t> g_allocCount{0};     // 分配次数
-std::atomic<size_t> g_freeCount{0};      // 释放次数
-std::atomic<size_t> g_currentMemory{0};  // 当前内存（字节）
-std::atomic<size_t> g_peakMemory{0};     // 峰值内存（字节）
-#endif
+// 统计：分配/释放次数、使用中的字节数等记在每个线程自己的ThreadStats里（普通读写，没有原子的读-改-写），
+// 一直开着，调用GetPoolStats()时才汇总，见PoolStats.h
+// 编译时添加 -DENABLE_LOCK_PROFILE（或者原来的 -DENABLE_STATS）按每把锁统计竞争次数和等待/持有时间分布，
+// GetLockProfile()/PrintLockProfile()查看
+// 堆采样：SetHeapSampleRate(rate)开启后按分配字节数随机采样调用栈，DumpHeapProfile(path)输出，见HeapProfiler.h
 
 // 统一对外接口 - 隐藏内部实现细节
 // 提供类似malloc/free的简洁接口
@@ -22,52 +20,335 @@ std::atomic<size_t> g_peakMemory{0};     // 峰值内存（字节）
 // 统一分配接口
 static inline void* ConcurrentAlloc(size_t size)
 {
-#ifdef ENABLE_STATS
-    // 性能统计：记录分配
-    g_allocCount++;
-    g_currentMemory += size;
-    
-    // 更新峰值内存（多线程环境下可能有小误差，但统计场景可接受）
-    size_t current = g_currentMemory.load();
-    size_t peak = g_peakMemory.load();
-    if (current > peak) {
-        g_peakMemory.store(current);
+    // 采样倒计数减成负数才进慢路径（没开启采样时每HEAP_SAMPLE_RECHECK_BYTES字节进一次）
+    if ((tBytesUntilSample -= (intptr_t)size) < 0)
+    {
+        void* ptr = HeapProfiler::GetInstance()->Allocate(size);
+        if (ptr != nullptr) {
+            return ptr;
+        }
     }
-#endif
-    
-    // 大内存（>256KB）直接走malloc，不使用内存池
-    // 原因：大内存走内存池效率低，且占用资源
+
+    // 大内存（>256KB）不走ThreadCache，直接向PageCache按页申请一个Span
+    // Span的_objSize记录按页对齐后的大小（一定大于MAX_BYTES），不带size释放时据此区分大小内存
     if (size > MAX_BYTES)
     {
-        return malloc(size);
+        size_t alignSize = SizeClass::RoundUp(size);
+        size_t kpage = alignSize >> PAGE_SHIFT;
+        
+        Span* span = PageCache::GetInstance()->NewSpan(kpage);
+        span->_objSize = alignSize;
+        GetThreadStats()->AddLarge(alignSize);
+        return (void*)(span->_pageId << PAGE_SHIFT);
     }
     else
     {
-        // 小内存走三层缓存架构
-        return GetTLSThreadCache()->Allocate(size);
+        // 小内存走三层缓存架构（开启ENABLE_PERCPU时前端换成per-CPU缓存）
+        return FrontEndAllocate(size);
     }
 }
 
+// 有还没释放的采样时，带size（或索引）释放的小对象也可能是单独占一个Span的采样：
+// 查一次页表确认，是的话删掉采样、还掉Span，返回true；没有采样时只多一次读和一个分支
+static inline bool FreeIfSampled(void* ptr)
+{
+    if (gHeapLiveSamples.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(ptr);
+    if (span->_sample == nullptr) {
+        return false;
+    }
+    HeapProfiler::GetInstance()->Free(span);
+    return true;
+}
+
 // 统一释放接口
 static inline void ConcurrentFree(void* ptr, size_t size)
 {
-#ifdef ENABLE_STATS
-    // 性能统计：记录释放
-    g_freeCount++;
-    g_currentMemory -= size;
-#endif
-    
     // 根据size判断是大内存还是小内存
     if (size > MAX_BYTES)
     {
-        // 大内存直接free
-        free(ptr);
+        // 大内存整个Span还给PageCache（统计按Span实际的页数，原地调整过大小也对得上）
+        Span* span = PageCache::GetInstance()->MapObjectToSpan(ptr);
+        if (span->_sample != nullptr) {
+            HeapProfiler::GetInstance()->Free(span);
+            return;
+        }
+        GetThreadStats()->SubLarge(span->_n << PAGE_SHIFT);
+        PageCache::GetInstance()->ReleaseSpanToPageCache(span);
     }
     else
     {
+        if (FreeIfSampled(ptr)) {
+            return;
+        }
         // 小内存归还给内存池
-        GetTLSThreadCache()->Deallocate(ptr, size);
+        FrontEndDeallocate(ptr, size);
+    }
+}
+
+// 不带size的释放接口：通过页表找到对象所属的Span，用Span记录的对象大小释放
+// 页表查询无锁，只比带size的版本多一次基数树查找
+static inline void ConcurrentFree(void* ptr)
+{
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(ptr);
+    assert(span);
+    if (span->_sample != nullptr)
+    {
+        HeapProfiler::GetInstance()->Free(span);
+        return;
     }
+    size_t size = span->_objSize;
+    
+    if (size > MAX_BYTES)
+    {
+        // 大内存：Span本身就是这块内存，直接还给PageCache
+        GetThreadStats()->SubLarge(span->_n << PAGE_SHIFT);
+        PageCache::GetInstance()->ReleaseSpanToPageCache(span);
+    }
+    else
+    {
+        FrontEndDeallocate(ptr, size);
+    }
+}
+
+// 按size class索引分配/释放：调用方已经知道索引（比如在编译期由sizeof(T)算出），跳过Index计算
+// 只用于小对象（index < NFREELIST），释放时的索引必须和分配时一致
+// 和ConcurrentAlloc一样扣采样倒计数（按size class的大小），PoolAllocator/ConcurrentNew的分配也会被采样
+static inline void* ConcurrentAllocIndex(size_t index)
+{
+    assert(index < NFREELIST);
+    if ((tBytesUntilSample -= (intptr_t)SizeClass::Size(index)) < 0)
+    {
+        void* ptr = HeapProfiler::GetInstance()->Allocate(SizeClass::Size(index));
+        if (ptr != nullptr) {
+            return ptr;
+        }
+    }
+    return FrontEndAllocateIndex(index);
+}
+
+static inline void ConcurrentFreeIndex(void* ptr, size_t index)
+{
+    assert(index < NFREELIST);
+    if (FreeIfSampled(ptr)) {
+        return;
+    }
+    FrontEndDeallocateIndex(ptr, index);
+}
+
+// 批量分配接口：一次分配n个size字节的对象，写入out[0..n)
+// 小对象整段从ThreadCache的FreeList取，不够的按批从传输缓存/CentralCache取，只查一次TLS、算一次索引
+// 大内存和per-CPU前端没有可以整段取的链表，逐个分配
+// 整批一次扣采样倒计数，扣成负数说明这一批里有采样点，改成逐个分配（每个对象各自扣倒计数，到点的被采样）
+static inline void ConcurrentAllocBatch(size_t size, size_t n, void** out)
+{
+#ifndef PERCPU_RSEQ
+    if (size <= MAX_BYTES)
+    {
+        intptr_t bytes = (intptr_t)(size * n);
+        if ((tBytesUntilSample -= bytes) >= 0) {
+            GetTLSThreadCache()->AllocateBatch(size, n, out);
+            return;
+        }
+        tBytesUntilSample += bytes;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = ConcurrentAlloc(size);
+    }
+}
+
+// 批量释放接口：ptrs[0..n)都是size字节的对象，整段挂回ThreadCache的FreeList
+// 有还没释放的采样时，其中可能有单独占Span的采样对象，逐个释放
+static inline void ConcurrentFreeBatch(void** ptrs, size_t n, size_t size)
+{
+#ifndef PERCPU_RSEQ
+    if (size <= MAX_BYTES && gHeapLiveSamples.load(std::memory_order_relaxed) == 0)
+    {
+        GetTLSThreadCache()->DeallocateBatch(ptrs, n, size);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        ConcurrentFree(ptrs[i], size);
+    }
+}
+
+// 对齐分配时实际向内存池申请的大小（alignment为2的幂）
+// 1.alignment不超过一页：找对象大小是alignment整数倍的size class，Span按页对齐，切出来的对象天然对齐
+// 2.alignment超过一页：大内存Span只保证按页对齐，多申请alignment-1页的余量，返回Span内部对齐的地址
+static inline size_t AlignedAllocSize(size_t size, size_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    if (alignment <= ((size_t)1 << PAGE_SHIFT)) {
+        size_t alignSize = SizeClass::RoundUp(size > alignment ? size : alignment);
+        while (alignSize <= MAX_BYTES && alignSize % alignment != 0) {
+            alignSize = SizeClass::RoundUp(alignSize + 1);
+        }
+        return alignSize;
+    }
+    size_t need = SizeClass::_RoundUp(size ? size : 1, (size_t)1 << PAGE_SHIFT) + alignment - ((size_t)1 << PAGE_SHIFT);
+    return need > MAX_BYTES ? need : MAX_BYTES + 1;  // 保证走大内存Span
+}
+
+// 对齐分配接口：返回的地址是alignment的整数倍（alignment为2的幂）
+// 释放用ConcurrentFree(ptr)或ConcurrentAlignedFree：大对齐返回的是Span内部地址，
+// 大内存Span每一页都在页表里，用内部地址也能找到整个Span
+static inline void* ConcurrentAlignedAlloc(size_t size, size_t alignment)
+{
+    void* ptr = ConcurrentAlloc(AlignedAllocSize(size, alignment));
+    return (void*)(((uintptr_t)ptr + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+// 带size的对齐释放，size和alignment必须和申请时一致（实际的size class可能比size大，不能直接用ConcurrentFree(ptr, size)）
+static inline void ConcurrentAlignedFree(void* ptr, size_t size, size_t alignment)
+{
+    ConcurrentFree(ptr, AlignedAllocSize(size, alignment));
+}
+
+// 大内存原地调整：ptr所在的Span按页增减（ptr可能是对齐分配返回的Span内部地址），调整不了返回false
+static inline bool ResizeLargeInPlace(Span* span, void* ptr, size_t newSize)
+{
+    size_t offset = (char*)ptr - (char*)(span->_pageId << PAGE_SHIFT);
+    size_t kpage = (offset + newSize + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+    size_t oldPages = span->_n;
+    if (!PageCache::GetInstance()->ResizeSpan(span, kpage)) {
+        return false;
+    }
+    span->_objSize = kpage << PAGE_SHIFT;
+    if (span->_sample != nullptr) {
+        HeapProfiler::GetInstance()->Resize(span, newSize);
+    }
+    ThreadStats& stats = *GetThreadStats();
+    if (kpage > oldPages) {
+        stats.largeAllocBytes.Add((kpage - oldPages) << PAGE_SHIFT);
+    }
+    else {
+        stats.largeFreeBytes.Add((oldPages - kpage) << PAGE_SHIFT);
+    }
+    return true;
+}
+
+// 重新分配接口，语义和realloc一样：ptr为nullptr时相当于分配，newSize为0时释放并返回nullptr
+// 1.小内存：新旧大小对齐到同一个size class，原指针直接返回
+// 2.大内存：先试着原地调整Span的页数（变小把尾部还回PageCache，变大占用后面紧挨着的空闲页）
+// 3.都不行才申请新内存、拷贝、释放旧内存
+// oldSize必须是申请时的大小，之后用ConcurrentFree(ptr, newSize)释放
+static inline void* ConcurrentRealloc(void* ptr, size_t oldSize, size_t newSize)
+{
+    if (ptr == nullptr) {
+        return ConcurrentAlloc(newSize);
+    }
+    if (newSize == 0) {
+        ConcurrentFree(ptr, oldSize);
+        return nullptr;
+    }
+
+    bool inPlace = false;
+    if (oldSize <= MAX_BYTES && newSize <= MAX_BYTES) {
+        inPlace = SizeClass::RoundUp(oldSize) == SizeClass::RoundUp(newSize);
+    }
+    else if (oldSize > MAX_BYTES && newSize > MAX_BYTES) {
+        inPlace = ResizeLargeInPlace(PageCache::GetInstance()->MapObjectToSpan(ptr), ptr, newSize);
+    }
+    if (inPlace) {
+        return ptr;
+    }
+
+    void* newPtr = ConcurrentAlloc(newSize);
+    memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+    ConcurrentFree(ptr, oldSize);
+    return newPtr;
+}
+
+// 不带size的重新分配：通过页表查到原对象的实际大小，用ConcurrentFree(ptr)释放
+// 小内存只要新大小放得下、又能用上原对象的一半以上就原地返回（缩得太小换个小的size class，不浪费）
+static inline void* ConcurrentRealloc(void* ptr, size_t newSize)
+{
+    if (ptr == nullptr) {
+        return ConcurrentAlloc(newSize);
+    }
+    if (newSize == 0) {
+        ConcurrentFree(ptr);
+        return nullptr;
+    }
+
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(ptr);
+    assert(span);
+    size_t usable = span->_objSize;
+    if (usable <= MAX_BYTES) {
+        if (newSize <= usable && SizeClass::RoundUp(newSize) * 2 > usable) {
+            return ptr;
+        }
+    }
+    else {
+        usable = (char*)((span->_pageId + span->_n) << PAGE_SHIFT) - (char*)ptr;
+        if (newSize > MAX_BYTES && ResizeLargeInPlace(span, ptr, newSize)) {
+            return ptr;
+        }
+    }
+
+    void* newPtr = ConcurrentAlloc(newSize);
+    memcpy(newPtr, ptr, usable < newSize ? usable : newSize);
+    ConcurrentFree(ptr);
+    return newPtr;
+}
+
+// NUMA接口（编译时添加 -DENABLE_NUMA 开启，否则只有节点0）
+// 把当前线程固定到一个节点，之后这个线程的分配都优先用该节点的内存
+static inline bool ConcurrentBindThreadToNode(size_t node)
+{
+    if (!NumaTopology::GetInstance()->BindThread(node)) {
+        return false;
+    }
+    if (pTLSThreadCache != nullptr) {
+        pTLSThreadCache->SetNode(node);
+    }
+    return true;
+}
+
+// 在指定节点上分配，不管当前线程在哪个节点，用ConcurrentFree释放
+static inline void* ConcurrentAllocOnNode(size_t size, size_t node)
+{
+    assert(node < NumaTopology::GetInstance()->NodeCount());
+    // 和ConcurrentAlloc一样扣采样倒计数，被采样的分配同样在指定节点上
+    if ((tBytesUntilSample -= (intptr_t)size) < 0)
+    {
+        void* ptr = HeapProfiler::GetInstance()->AllocateOnNode(size, node);
+        if (ptr != nullptr) {
+            return ptr;
+        }
+    }
+    size_t alignSize = SizeClass::RoundUp(size);
+    if (size > MAX_BYTES)
+    {
+        Span* span = PageCache::GetInstance()->NewSpanOnNode(alignSize >> PAGE_SHIFT, node);
+        span->_objSize = alignSize;
+        GetThreadStats()->AddLarge(alignSize);
+        return (void*)(span->_pageId << PAGE_SHIFT);
+    }
+#ifndef PERCPU_RSEQ
+    // 正好是当前线程的节点，走正常的ThreadCache
+    if (GetTLSThreadCache()->GetNode() == node) {
+        return FrontEndAllocate(size);
+    }
+#endif
+    // 别的节点：直接从那个节点的CentralCache取一个，不进当前线程的缓存
+    void* start = nullptr;
+    void* end = nullptr;
+    CentralCache::GetInstance()->FetchRangeObj(start, end, alignSize, 1, node);
+    ClassStats& stats = GetThreadStats()->classes[SizeClass::Index(size)];
+    stats.fetched.Add(1);
+    stats.allocs.Add(1);
+    return start;
+}
+
+// 一块内存所属的节点（分配器按哪个节点分配的）
+static inline size_t ConcurrentNodeOf(void* ptr)
+{
+    return PageCache::NodeOf(PageCache::GetInstance()->MapObjectToSpan(ptr));
 }
 
 // 内存池预热：减少冷启动开销
@@ -0,0 +1,332 @@
+#pragma once
+
+// 采样堆分析 - 按分配的字节数随机采样，记下被采样分配的调用栈，输出pprof能读的堆profile
+// 1.每个线程有一个"距离下次采样还剩多少字节"的倒计数，ConcurrentAlloc每次减去申请的大小，减成负数才进慢路径
+//   两次采样的间隔服从均值为采样率的指数分布，越大的分配越容易被采到，pprof按同样的概率把采样还原成总量
+// 2.被采样的分配单独占一个Span（小对象也是，浪费不到一页），Span::_sample指向采样记录，
+//   释放时顺着页表查到的Span找到记录删掉，不需要额外的哈希表；没被采样的分配完全不受影响
+// 3.默认关闭（采样率为0）：快路径只多一次减法和一个几乎从不跳转的分支。慢路径发现没开启，
+//   就把倒计数设成HEAP_SAMPLE_RECHECK_BYTES，之后这个线程每分配这么多字节才重新看一次采样率
+// 4.DumpHeapProfile(path)把还没释放的采样按gperftools的heap profile文本格式写到文件，
+//   可以直接用 pprof --text ./your_program heap.prof 查看。写文件的过程不调用malloc，LD_PRELOAD时也能用
+// Windows上没有backtrace，不会采样，DumpHeapProfile返回false
+#include "Common.h"
+#include "ObjectPool.h"
+#include "ThreadCache.h"
+#include "PageCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifndef _WIN32
+#include <execinfo.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+static const size_t HEAP_SAMPLE_MAX_DEPTH = 32;                // 每个采样最多记录的栈帧数
+static const intptr_t HEAP_SAMPLE_RECHECK_BYTES = 1 << 20;     // 关闭时每个线程隔多少字节重新检查一次采样率
+
+// 一次被采样的分配，挂在HeapProfiler的双向链表上
+struct HeapSample {
+    HeapSample* _prev = nullptr;
+    HeapSample* _next = nullptr;
+    size_t _size = 0;                       // 申请的大小
+    size_t _depth = 0;                      // 栈帧数
+    void* _stack[HEAP_SAMPLE_MAX_DEPTH];    // 返回地址，从调用ConcurrentAlloc的函数开始
+};
+
+// 距离下次采样还剩的字节数（每个线程一份，ConcurrentAlloc直接读写）
+static thread_local intptr_t tBytesUntilSample = 0;
+
+// 还没释放的采样数。放在命名空间作用域、常量初始化，带size的释放路径判断"有没有采样"只是一次读和一个分支，
+// 不用经过GetInstance()里局部静态变量的初始化检查
+inline std::atomic<size_t> gHeapLiveSamples{0};
+
+class HeapProfiler {
+public:
+    static HeapProfiler* GetInstance() {
+        static HeapProfiler instance;
+        return &instance;
+    }
+
+    // 平均每分配rate字节采样一次，0表示关闭。调用线程立即生效，其他线程最多再分配HEAP_SAMPLE_RECHECK_BYTES后生效
+    void SetSampleRate(size_t rate) {
+#ifndef _WIN32
+        if (rate != 0) {
+            // glibc第一次调用backtrace时要加载libgcc_s（会调malloc），先在这里触发，不要等到分配路径上
+            void* frame[1];
+            backtrace(frame, 1);
+        }
+#endif
+        _rate.store(rate, std::memory_order_relaxed);
+        tBytesUntilSample = 0;
+    }
+
+    size_t GetSampleRate() const { return _rate.load(std::memory_order_relaxed); }
+
+    // 还没释放的采样数
+    size_t GetLiveSamples() const { return gHeapLiveSamples.load(std::memory_order_relaxed); }
+
+    // 倒计数减成负数时调用：到了采样点就分配并记录调用栈，返回nullptr表示这次不采样，走正常分配
+    POOL_NOINLINE void* Allocate(size_t size) {
+        return SampleAllocate(size, NumaTopology::GetInstance()->CurrentNode());
+    }
+
+    // 同上，采样的Span从指定的NUMA节点分配（ConcurrentAllocOnNode用）
+    POOL_NOINLINE void* AllocateOnNode(size_t size, size_t node) {
+        return SampleAllocate(size, node);
+    }
+
+    // 释放一个被采样的分配：删掉采样记录，整个Span还给PageCache
+    void Free(Span* span) {
+        assert(span->_sample != nullptr);
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            HeapSample* sample = span->_sample;
+            sample->_prev->_next = sample->_next;
+            sample->_next->_prev = sample->_prev;
+            _samplePool.Delete(sample);
+            span->_sample = nullptr;
+        }
+        gHeapLiveSamples.fetch_sub(1, std::memory_order_relaxed);
+        GetThreadStats()->SubLarge(span->_n << PAGE_SHIFT);
+        PageCache::GetInstance()->ReleaseSpanToPageCache(span);
+    }
+
+    // 被采样的大内存原地调整了大小
+    void Resize(Span* span, size_t newSize) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        span->_sample->_size = newSize;
+    }
+
+    // fork前后加解锁采样链表的锁（见MallocOverride.cpp）
+    void Lock() { _mtx.lock(); }
+    void Unlock() { _mtx.unlock(); }
+
+    // 把还没释放的采样写成gperftools的heap profile（legacy文本格式）：
+    //   heap profile: <对象数>: <字节数> [<对象数>: <字节数>] @ heap_v2/<采样率>
+    //   <对象数>: <字节数> [<对象数>: <字节数>] @ 0x... 0x...     （相同调用栈合并成一行）
+    //   MAPPED_LIBRARIES:
+    //   <复制/proc/self/maps，pprof用来把地址对应到可执行文件和动态库>
+    // 对象数和字节数都是采样到的原始值，pprof按采样率还原。失败返回false
+    bool Dump(const char* path) {
+#ifdef _WIN32
+        (void)path;
+        return false;
+#else
+        // 1.加锁把采样复制到一块直接向系统申请的内存里（不能用malloc），马上解锁，不挡住分配和释放
+        std::unique_lock<std::mutex> lock(_mtx);
+        size_t count = 0;
+        for (HeapSample* s = _head._next; s != &_head; s = s->_next) {
+            ++count;
+        }
+        size_t bytes = count * (sizeof(HeapSample) + sizeof(HeapSample*));
+        size_t kpage = (bytes + ((size_t)1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+        HeapSample* copies = kpage ? (HeapSample*)SystemAlloc(kpage) : nullptr;
+        HeapSample** sorted = (HeapSample**)(copies + count);
+        size_t n = 0;
+        for (HeapSample* s = _head._next; s != &_head; s = s->_next) {
+            copies[n] = *s;
+            sorted[n] = &copies[n];
+            ++n;
+        }
+        lock.unlock();
+
+        // 2.按调用栈排序，相同的调用栈挨在一起
+        std::sort(sorted, sorted + n, [](const HeapSample* a, const HeapSample* b) {
+            if (a->_depth != b->_depth) {
+                return a->_depth < b->_depth;
+            }
+            return memcmp(a->_stack, b->_stack, a->_depth * sizeof(void*)) < 0;
+        });
+
+        bool ok = false;
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            ProfileWriter out(fd);
+            size_t totalBytes = 0;
+            for (size_t i = 0; i < n; ++i) {
+                totalBytes += sorted[i]->_size;
+            }
+            out.Printf("heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", n, totalBytes, n, totalBytes,
+                       GetSampleRate());
+
+            // 3.合并相同调用栈，一组一行
+            for (size_t i = 0; i < n;) {
+                size_t j = i;
+                size_t groupBytes = 0;
+                while (j < n && sorted[j]->_depth == sorted[i]->_depth &&
+                       memcmp(sorted[j]->_stack, sorted[i]->_stack, sorted[i]->_depth * sizeof(void*)) == 0) {
+                    groupBytes += sorted[j]->_size;
+                    ++j;
+                }
+                out.Printf("%zu: %zu [%zu: %zu] @", j - i, groupBytes, j - i, groupBytes);
+                for (size_t d = 0; d < sorted[i]->_depth; ++d) {
+                    out.Printf(" %p", sorted[i]->_stack[d]);
+                }
+                out.Printf("\n");
+                i = j;
+            }
+
+            // 4.附上内存映射
+            out.Printf("\nMAPPED_LIBRARIES:\n");
+            int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+            if (maps >= 0) {
+                char buf[4096];
+                ssize_t len;
+                while ((len = read(maps, buf, sizeof(buf))) > 0) {
+                    out.Write(buf, (size_t)len);
+                }
+                close(maps);
+            }
+            ok = out.Flush();
+            ok = close(fd) == 0 && ok;
+        }
+
+        if (copies != nullptr) {
+            SystemFree(copies, kpage);
+        }
+        return ok;
+#endif
+    }
+
+private:
+    HeapProfiler() {
+        _head._prev = _head._next = &_head;
+    }
+    HeapProfiler(const HeapProfiler&) = delete;
+    HeapProfiler& operator=(const HeapProfiler&) = delete;
+
+    // Allocate/AllocateOnNode的实现
+    POOL_ALWAYS_INLINE void* SampleAllocate(size_t size, size_t node) {
+        size_t rate = GetSampleRate();
+        if (rate == 0) {
+            tBytesUntilSample = HEAP_SAMPLE_RECHECK_BYTES;
+            return nullptr;
+        }
+        tBytesUntilSample = NextInterval(rate);
+#ifdef _WIN32
+        (void)size;
+        (void)node;
+        return nullptr;
+#else
+        // 在锁外取调用栈，跳过Allocate/AllocateOnNode这一帧（SampleAllocate强制内联，没有自己的帧）
+        void* stack[HEAP_SAMPLE_MAX_DEPTH + 1];
+        int depth = backtrace(stack, HEAP_SAMPLE_MAX_DEPTH + 1);
+
+        // 单独一个Span：大内存和正常分配一样按页取整，小对象占整页，_objSize记size class大小（不带size释放、realloc用）
+        size_t pageBytes = SizeClass::_RoundUp(size ? size : 1, (size_t)1 << PAGE_SHIFT);
+        size_t kpage = (size > MAX_BYTES ? SizeClass::RoundUp(size) : pageBytes) >> PAGE_SHIFT;
+        Span* span = PageCache::GetInstance()->NewSpanOnNode(kpage, node);
+        span->_objSize = size > MAX_BYTES ? kpage << PAGE_SHIFT : SizeClass::RoundUp(size);
+        // 统计里按大内存计（释放时同样按Span的页数扣掉），不影响size class的对象数
+        GetThreadStats()->AddLarge(kpage << PAGE_SHIFT);
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            HeapSample* sample = _samplePool.New();
+            sample->_size = size;
+            sample->_depth = depth > 1 ? depth - 1 : 0;
+            memcpy(sample->_stack, stack + 1, sample->_depth * sizeof(void*));
+            sample->_next = _head._next;
+            sample->_prev = &_head;
+            _head._next->_prev = sample;
+            _head._next = sample;
+            span->_sample = sample;
+        }
+        gHeapLiveSamples.fetch_add(1, std::memory_order_relaxed);
+        return (void*)(span->_pageId << PAGE_SHIFT);
+#endif
+    }
+
+    // 下一次采样前要分配的字节数：均值为rate的指数分布（泊松过程），随机数用每个线程自己的xorshift
+    static intptr_t NextInterval(size_t rate) {
+        static thread_local uint64_t state = 0;
+        if (state == 0) {
+            state = (uint64_t)(uintptr_t)&state * 0x9E3779B97F4A7C15ull | 1;
+        }
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        // 取高53位作为(0, 1]之间的均匀分布，-ln(u)服从均值为1的指数分布
+        double u = (double)((state >> 11) + 1) / (double)(1ull << 53);
+        double interval = -std::log(u) * (double)rate;
+        double maxInterval = (double)((uintptr_t)1 << 40);
+        return interval < maxInterval ? (intptr_t)interval : (intptr_t)maxInterval;
+    }
+
+#ifndef _WIN32
+    // 带缓冲的文件输出，只用栈上的缓冲区和write(2)
+    class ProfileWriter {
+    public:
+        explicit ProfileWriter(int fd) : _fd(fd) {}
+
+        template <class... Args>
+        void Printf(const char* fmt, Args... args) {
+            char line[256];
+            int len = snprintf(line, sizeof(line), fmt, args...);
+            if (len > 0) {
+                Write(line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+            }
+        }
+
+        void Write(const char* data, size_t len) {
+            while (len > 0) {
+                if (_used == sizeof(_buf) && !Flush()) {
+                    return;
+                }
+                size_t n = std::min(len, sizeof(_buf) - _used);
+                memcpy(_buf + _used, data, n);
+                _used += n;
+                data += n;
+                len -= n;
+            }
+        }
+
+        bool Flush() {
+            size_t off = 0;
+            while (off < _used) {
+                ssize_t n = write(_fd, _buf + off, _used - off);
+                if (n <= 0) {
+                    _ok = false;
+                    break;
+                }
+                off += (size_t)n;
+            }
+            _used = 0;
+            return _ok;
+        }
+
+    private:
+        int _fd;
+        bool _ok = true;
+        size_t _used = 0;
+        char _buf[8192];
+    };
+#endif
+
+    std::atomic<size_t> _rate{0};
+    std::mutex _mtx;                        // 保护采样链表和_samplePool
+    HeapSample _head;                       // 采样链表的哨兵
+    ObjectPool<HeapSample> _samplePool;
+};
+
+// ========== 对外接口 ==========
+
+// 开启/关闭采样：平均每分配rate字节采样一次（比如512KB），0表示关闭（默认）
+static inline void SetHeapSampleRate(size_t rate)
+{
+    HeapProfiler::GetInstance()->SetSampleRate(rate);
+}
+
+static inline size_t GetHeapSampleRate()
+{
+    return HeapProfiler::GetInstance()->GetSampleRate();
+}
+
+// 把当前还没释放的采样写到path，格式见HeapProfiler::Dump
+static inline bool DumpHeapProfile(const char* path)
+{
+    return HeapProfiler::GetInstance()->Dump(path);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// 锁竞争统计（编译时添加 -DENABLE_LOCK_PROFILE 开启，默认关闭）
+// 开启后CentralCache的桶锁、传输缓存的槽位锁、PageCache的分片锁换成ProfiledMutex，每把锁记录：
+//   加锁次数、其中没能立即拿到（竞争）的次数、等待时间和持有时间的累计值及直方图
+// 先try_lock，拿到了就不计等待时间，拿不到才读时钟计时再阻塞等待；持有时间在解锁前算出
+// 所有计数都在这把锁内更新（等待时间在拿到锁之后记），用StatCounter普通读写，读的时候不用加锁
+// 用来找哪些size class的桶锁需要进一步拆分，以及ReleaseListToSpans在归还Span前后解锁再加锁会不会造成排队
+// （排队会体现在对应桶的竞争次数和等待时间分布上）
+// 每次加解锁多读两次时钟（竞争时三次），只用来分析，不要在生产环境开启
+// 汇总和打印见PoolStats.h的GetLockProfile/PrintLockProfile
+// 原来的 -DENABLE_STATS（CentralCache/传输缓存锁的合计持有时间）合并到这里，等同于 -DENABLE_LOCK_PROFILE
+#include "Common.h"
+#include <mutex>
+#include <chrono>
+
+#if defined(ENABLE_STATS) && !defined(ENABLE_LOCK_PROFILE)
+    #define ENABLE_LOCK_PROFILE
+#endif
+
+// 等待/持有时间直方图的桶数：第0个桶是不到64ns，第k个桶是[64ns << (k-1), 64ns << k)，最后一个桶是1ms以上
+static const size_t LOCK_HIST_BUCKETS = 16;
+
+static inline size_t LockHistBucket(uint64_t ns)
+{
+    size_t bucket = 0;
+    for (ns >>= 6; ns != 0 && bucket < LOCK_HIST_BUCKETS - 1; ns >>= 1) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+// 第k个桶的上界（纳秒），最后一个桶没有上界，返回它的下界
+static inline uint64_t LockHistBound(size_t bucket)
+{
+    return bucket < LOCK_HIST_BUCKETS - 1 ? (uint64_t)64 << bucket : (uint64_t)64 << (bucket - 1);
+}
+
+// 一把锁的计数，在这把锁内更新
+struct LockCounters {
+    StatCounter acquisitions;                   // 加锁次数
+    StatCounter contended;                      // 其中没能立即拿到、需要等待的次数
+    StatCounter waitNs;                         // 累计等待时间
+    StatCounter holdNs;                         // 累计持有时间
+    StatCounter waitHist[LOCK_HIST_BUCKETS];    // 每次加锁的等待时间分布（没竞争的算0）
+    StatCounter holdHist[LOCK_HIST_BUCKETS];    // 每次持有时间的分布
+};
+
+// 带统计的互斥锁，接口和std::mutex一样（lock/try_lock/unlock），可以直接用std::lock_guard
+class ProfiledMutex {
+public:
+    void lock() {
+        if (_mtx.try_lock()) {
+            _counters.acquisitions.Add(1);
+            _counters.waitHist[0].Add(1);
+            _lockStart = NowNs();
+            return;
+        }
+        uint64_t start = NowNs();
+        _mtx.lock();
+        _lockStart = NowNs();  // 拿到锁的时间点同时是等待的结束和持有的开始
+        uint64_t wait = _lockStart - start;
+        _counters.acquisitions.Add(1);
+        _counters.contended.Add(1);
+        _counters.waitNs.Add(wait);
+        _counters.waitHist[LockHistBucket(wait)].Add(1);
+    }
+
+    bool try_lock() {
+        if (!_mtx.try_lock()) {
+            return false;
+        }
+        _counters.acquisitions.Add(1);
+        _counters.waitHist[0].Add(1);
+        _lockStart = NowNs();
+        return true;
+    }
+
+    void unlock() {
+        uint64_t hold = NowNs() - _lockStart;
+        _counters.holdNs.Add(hold);
+        _counters.holdHist[LockHistBucket(hold)].Add(1);
+        _mtx.unlock();
+    }
+
+    const LockCounters& Counters() const { return _counters; }
+
+private:
+    std::mutex _mtx;
+    uint64_t _lockStart = 0;  // 本次加锁的时间点，在锁内读写
+    LockCounters _counters;
+};
+
+// 内存池内部各层共用的锁类型
+#ifdef ENABLE_LOCK_PROFILE
+using CacheMutex = ProfiledMutex;
+#else
+using CacheMutex = std::mutex;
+#endif
@@ -0,0 +1,378 @@
+// malloc/free/new/delete 替换库（Linux）
+// 编译成动态库后通过LD_PRELOAD注入，不改业务代码就能把所有分配切到内存池上：
+//   g++ -std=c++17 -O2 -fPIC -shared -fvisibility=hidden -ftls-model=initial-exec
+//       src/MallocOverride.cpp src/CentralCache.cpp src/PageCache.cpp -o libconcurrentmalloc.so -pthread
+//   LD_PRELOAD=./libconcurrentmalloc.so ./your_program
+//
+// 注意：
+//   1.内存池自己的元数据（Span、ThreadCache）都来自ObjectPool，不会再调malloc；
+//     但内存池执行过程中仍可能间接触发分配（比如抛bad_alloc时分配异常对象），
+//     用线程局部的重入计数识别，重入时改用自举分配器（直接向系统申请的小块内存），避免递归和死锁
+//   2.自举分配器的内存不在页表里，释放时据此识别，直接忽略（数量很少，不回收）
+//   3.malloc要求返回的内存至少16字节对齐，这里把申请大小向上取整到16字节的倍数
+//   4.注册了pthread_atfork：fork前拿住内存池的所有锁，fork后父子进程各自释放，
+//     子进程不会继承一把被别的线程（子进程里已经不存在）拿着的锁；子进程里没有后台回收线程
+#include "ConcurrentMemoryPool.h"
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <new>
+
+#define HOOK_API extern "C" __attribute__((visibility("default")))
+#define HOOK_CXX __attribute__((visibility("default")))
+
+static const size_t MIN_ALIGN = 16;  // malloc的最小对齐要求（alignof(max_align_t)）
+
+// ========== 重入检测 ==========
+
+// 当前线程正在执行内存池代码的层数，大于0时说明是内存池内部的分配
+static thread_local int t_hookDepth __attribute__((tls_model("initial-exec"))) = 0;
+
+struct HookGuard {
+    HookGuard() { ++t_hookDepth; }
+    ~HookGuard() { --t_hookDepth; }
+};
+
+// ========== 自举分配器 ==========
+// 只在重入时使用，按16字节对齐做指针碰撞分配，每块前面16字节记录大小，供realloc/malloc_usable_size使用
+
+static const size_t BOOTSTRAP_CHUNK_PAGES = 16;  // 每次向系统申请128KB
+
+static std::mutex g_bootstrapMtx;
+static char* g_bootstrapCur = nullptr;
+static char* g_bootstrapEnd = nullptr;
+
+static void* BootstrapAlloc(size_t size) {
+    size_t need = SizeClass::_RoundUp(size, MIN_ALIGN) + MIN_ALIGN;  // 加上头部
+    char* block = nullptr;
+
+    std::lock_guard<std::mutex> lock(g_bootstrapMtx);
+    if (need > (BOOTSTRAP_CHUNK_PAGES << PAGE_SHIFT) / 4) {
+        // 比较大的块单独向系统申请，不浪费当前chunk
+        size_t kpage = (need + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+        block = (char*)SystemAlloc(kpage);
+    } else {
+        if (g_bootstrapCur == nullptr || (size_t)(g_bootstrapEnd - g_bootstrapCur) < need) {
+            g_bootstrapCur = (char*)SystemAlloc(BOOTSTRAP_CHUNK_PAGES);
+            g_bootstrapEnd = g_bootstrapCur + (BOOTSTRAP_CHUNK_PAGES << PAGE_SHIFT);
+        }
+        block = g_bootstrapCur;
+        g_bootstrapCur += need;
+    }
+
+    *(size_t*)block = size;
+    return block + MIN_ALIGN;
+}
+
+static size_t BootstrapSize(void* ptr) {
+    return *(size_t*)((char*)ptr - MIN_ALIGN);
+}
+
+// ========== fork ==========
+// 按固定顺序拿锁，和内存池里嵌套拿锁的顺序一致：
+//   回收线程的锁持有时会创建线程（间接申请内存），最先拿；
+//   对象池、采样、slab创建、传输缓存、CentralCache的锁都不会在持有时再拿别的锁，
+//   PageCache分片锁内会拿页表的_growMtx；任何锁内重入malloc都会走自举分配器，所以它的锁最后拿
+
+static void ForkPrepare() {
+    PageCache::GetInstance()->LockScavenger();
+    ThreadStats::LockPool();
+    ThreadCache::LockPool();
+    HeapProfiler::GetInstance()->Lock();
+#ifdef PERCPU_RSEQ
+    PerCpuCache::GetInstance()->LockInit();
+#endif
+    TransferCache::GetInstance()->LockAll();
+    CentralCache::GetInstance()->LockAll();
+    PageCache::GetInstance()->LockAll();
+    g_bootstrapMtx.lock();
+}
+
+static void ForkParent() {
+    g_bootstrapMtx.unlock();
+    PageCache::GetInstance()->UnlockAll();
+    CentralCache::GetInstance()->UnlockAll();
+    TransferCache::GetInstance()->UnlockAll();
+#ifdef PERCPU_RSEQ
+    PerCpuCache::GetInstance()->UnlockInit();
+#endif
+    HeapProfiler::GetInstance()->Unlock();
+    ThreadCache::UnlockPool();
+    ThreadStats::UnlockPool();
+    PageCache::GetInstance()->UnlockScavenger();
+}
+
+// 子进程里只剩调用fork的线程，就是拿着这些锁的线程，直接解锁即可
+static void ForkChild() {
+    ForkParent();
+    PageCache::GetInstance()->ResetAfterFork();
+}
+
+// 库加载时注册一次；先把单例都构造出来，fork时不会在拿着锁的情况下第一次构造它们
+__attribute__((constructor)) static void RegisterForkHandlers() {
+    PageCache::GetInstance();
+    HeapProfiler::GetInstance();
+#ifdef PERCPU_RSEQ
+    PerCpuCache::GetInstance();
+#endif
+    TransferCache::GetInstance();
+    CentralCache::GetInstance();
+    pthread_atfork(ForkPrepare, ForkParent, ForkChild);
+}
+
+// ========== 分配/释放的公共实现 ==========
+
+// 超过这个大小的申请肯定无法满足，提前拒绝，避免对齐计算溢出
+static const size_t MAX_ALLOC_SIZE = (size_t)1 << 46;
+
+static void* HookAlloc(size_t size) {
+    if (size > MAX_ALLOC_SIZE) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    if (t_hookDepth > 0) {
+        return BootstrapAlloc(size);
+    }
+
+    HookGuard guard;
+    try {
+        return ConcurrentAlloc(SizeClass::_RoundUp(size ? size : 1, MIN_ALIGN));
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+}
+
+// 按alignment对齐的分配（alignment为2的幂），规则见ConcurrentAlignedAlloc
+static void* HookAlignedAlloc(size_t size, size_t alignment) {
+    if (alignment <= MIN_ALIGN) {
+        return HookAlloc(size);
+    }
+    if (size > MAX_ALLOC_SIZE || alignment > MAX_ALLOC_SIZE) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    if (t_hookDepth > 0) {
+        // 重入时的对齐申请极少见，直接多申请再对齐（自举内存不会释放，不需要记原地址）
+        char* raw = (char*)BootstrapAlloc(size + alignment);
+        char* aligned = (char*)(((uintptr_t)raw + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        *(size_t*)(aligned - MIN_ALIGN) = size;  // 对齐后的地址前面同样记录大小
+        return aligned;
+    }
+
+    HookGuard guard;
+    try {
+        return ConcurrentAlignedAlloc(size, alignment);
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+}
+
+static void HookFree(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    // 不在页表里的只可能是自举分配器的内存
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(ptr);
+    if (span == nullptr) {
+        return;
+    }
+
+    HookGuard guard;
+    if (span->_sample != nullptr) {
+        HeapProfiler::GetInstance()->Free(span);
+    } else if (span->_objSize > MAX_BYTES) {
+        GetThreadStats()->SubLarge(span->_n << PAGE_SHIFT);
+        PageCache::GetInstance()->ReleaseSpanToPageCache(span);
+    } else {
+        FrontEndDeallocate(ptr, span->_objSize);
+    }
+}
+
+// 从ptr开始实际可用的字节数
+static size_t HookUsableSize(void* ptr) {
+    if (ptr == nullptr) {
+        return 0;
+    }
+
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(ptr);
+    if (span == nullptr) {
+        return BootstrapSize(ptr);
+    }
+    if (span->_objSize > MAX_BYTES) {
+        // 对齐分配返回的可能是Span内部地址
+        char* spanEnd = (char*)((span->_pageId + span->_n) << PAGE_SHIFT);
+        return spanEnd - (char*)ptr;
+    }
+    return span->_objSize;
+}
+
+static void* HookRealloc(void* ptr, size_t size) {
+    if (ptr == nullptr) {
+        return HookAlloc(size);
+    }
+    if (size == 0) {
+        HookFree(ptr);
+        return nullptr;
+    }
+
+    // 自举内存：放得下就原地返回，否则拷贝到新内存（自举内存不回收）
+    if (PageCache::GetInstance()->MapObjectToSpan(ptr) == nullptr) {
+        size_t oldSize = BootstrapSize(ptr);
+        if (size <= oldSize) {
+            return ptr;
+        }
+        void* newPtr = HookAlloc(size);
+        if (newPtr != nullptr) {
+            memcpy(newPtr, ptr, oldSize);
+        }
+        return newPtr;
+    }
+    if (size > MAX_ALLOC_SIZE || t_hookDepth > 0) {
+        // 重入时不能再进内存池，按分配新内存、拷贝、释放处理
+        void* newPtr = HookAlloc(size);
+        if (newPtr != nullptr) {
+            size_t oldSize = HookUsableSize(ptr);
+            memcpy(newPtr, ptr, oldSize < size ? oldSize : size);
+            HookFree(ptr);
+        }
+        return newPtr;
+    }
+
+    // 内存池的内存：同一个size class或者大内存能原地调整时不用拷贝
+    HookGuard guard;
+    try {
+        return ConcurrentRealloc(ptr, SizeClass::_RoundUp(size, MIN_ALIGN));
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+}
+
+// operator new失败时按标准要求循环调用new_handler
+static void* NewImpl(size_t size, size_t alignment) {
+    for (;;) {
+        void* ptr = alignment > MIN_ALIGN ? HookAlignedAlloc(size, alignment) : HookAlloc(size);
+        if (ptr != nullptr) {
+            return ptr;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void* NewNothrowImpl(size_t size, size_t alignment) noexcept {
+    try {
+        return NewImpl(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// ========== C接口 ==========
+
+HOOK_API void* malloc(size_t size) noexcept {
+    return HookAlloc(size);
+}
+
+HOOK_API void free(void* ptr) noexcept {
+    HookFree(ptr);
+}
+
+HOOK_API void* calloc(size_t n, size_t size) noexcept {
+    size_t total = n * size;
+    if (size != 0 && total / size != n) {
+        errno = ENOMEM;
+        return nullptr;  // 乘法溢出
+    }
+    void* ptr = HookAlloc(total);
+    if (ptr != nullptr) {
+        memset(ptr, 0, total);
+    }
+    return ptr;
+}
+
+HOOK_API void* realloc(void* ptr, size_t size) noexcept {
+    return HookRealloc(ptr, size);
+}
+
+HOOK_API int posix_memalign(void** memptr, size_t alignment, size_t size) noexcept {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void*) != 0) {
+        return EINVAL;
+    }
+    void* ptr = HookAlignedAlloc(size, alignment);
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+HOOK_API void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return HookAlignedAlloc(size, alignment);
+}
+
+// 和glibc一样不要求alignment是2的幂，向上取到下一个2的幂
+HOOK_API void* memalign(size_t alignment, size_t size) noexcept {
+    if (alignment > MAX_ALLOC_SIZE) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    size_t align = MIN_ALIGN;
+    while (align < alignment) {
+        align <<= 1;
+    }
+    return HookAlignedAlloc(size, align);
+}
+
+HOOK_API void* valloc(size_t size) noexcept {
+    return HookAlignedAlloc(size, sysconf(_SC_PAGESIZE));
+}
+
+HOOK_API void* pvalloc(size_t size) noexcept {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    return HookAlignedAlloc(SizeClass::_RoundUp(size ? size : 1, pageSize), pageSize);
+}
+
+HOOK_API size_t malloc_usable_size(void* ptr) noexcept {
+    return HookUsableSize(ptr);
+}
+
+// ========== C++ operator new/delete ==========
+
+HOOK_CXX void* operator new(size_t size) { return NewImpl(size, 0); }
+HOOK_CXX void* operator new[](size_t size) { return NewImpl(size, 0); }
+HOOK_CXX void* operator new(size_t size, const std::nothrow_t&) noexcept { return NewNothrowImpl(size, 0); }
+HOOK_CXX void* operator new[](size_t size, const std::nothrow_t&) noexcept { return NewNothrowImpl(size, 0); }
+
+HOOK_CXX void operator delete(void* ptr) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete[](void* ptr) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete(void* ptr, const std::nothrow_t&) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete[](void* ptr, const std::nothrow_t&) noexcept { HookFree(ptr); }
+// 带size的delete：自举内存也可能走到这里，统一按页表查Span释放
+HOOK_CXX void operator delete(void* ptr, size_t) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete[](void* ptr, size_t) noexcept { HookFree(ptr); }
+
+#if __cplusplus >= 201703L
+HOOK_CXX void* operator new(size_t size, std::align_val_t al) { return NewImpl(size, (size_t)al); }
+HOOK_CXX void* operator new[](size_t size, std::align_val_t al) { return NewImpl(size, (size_t)al); }
+HOOK_CXX void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return NewNothrowImpl(size, (size_t)al); }
+HOOK_CXX void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return NewNothrowImpl(size, (size_t)al); }
+
+HOOK_CXX void operator delete(void* ptr, std::align_val_t) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete[](void* ptr, std::align_val_t) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete(void* ptr, size_t, std::align_val_t) noexcept { HookFree(ptr); }
+HOOK_CXX void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { HookFree(ptr); }
+#endif
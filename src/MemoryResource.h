@@ -0,0 +1,126 @@
+#pragma once
+
+// std::pmr接口 - 让pmr容器用内存池
+// PoolMemoryResource：每次分配/释放都转给ConcurrentAlignedAlloc/ConcurrentAlignedFree，线程安全，所有实例等价
+// SpanArena：单调（monotonic）分配器，直接向PageCache整块申请Span，在Span里顺序切分，单个释放什么都不做，
+//   Release()时把所有Span一次还给PageCache。适合一个请求内创建大量短命对象、请求结束一起丢弃的场景：
+//   成千上万次单个释放变成几次Span释放。不是线程安全的，一个SpanArena只能同时被一个线程使用
+#include "ConcurrentMemoryPool.h"
+#include <memory_resource>
+
+class PoolMemoryResource : public std::pmr::memory_resource {
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        return ConcurrentAlignedAlloc(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        ConcurrentAlignedFree(p, bytes, alignment);
+    }
+
+    // 所有PoolMemoryResource共用同一个内存池，一个分配的内存可以由另一个释放
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other || dynamic_cast<const PoolMemoryResource*>(&other) != nullptr;
+    }
+};
+
+// 全局的PoolMemoryResource，可以用std::pmr::set_default_resource设为pmr容器的默认资源
+static inline PoolMemoryResource* GetPoolMemoryResource()
+{
+    static PoolMemoryResource resource;
+    return &resource;
+}
+
+// SpanArena每次向PageCache申请的Span页数：从initialPages开始每次翻倍，最多128页（PageCache缓存的最大Span）
+// 超过当前Span一半的大块单独申请一个刚好放得下的Span，不浪费当前Span的剩余空间
+class SpanArena : public std::pmr::memory_resource {
+public:
+    explicit SpanArena(size_t initialPages = 8)
+        : _nextPages(initialPages == 0 ? 1 : (initialPages < NPAGES - 1 ? initialPages : NPAGES - 1))
+    {}
+    SpanArena(const SpanArena&) = delete;
+    SpanArena& operator=(const SpanArena&) = delete;
+    ~SpanArena() override { Release(); }
+
+    // 把申请过的所有Span还给PageCache，之前分配的内存全部失效；之后还可以继续分配
+    void Release()
+    {
+        PageCache* pageCache = PageCache::GetInstance();
+        while (_spans != nullptr) {
+            Span* next = _spans->_next;
+            _spans->_next = nullptr;
+            pageCache->ReleaseSpanToPageCache(_spans);
+            _spans = next;
+        }
+        _cur = _end = nullptr;
+        _bytes = 0;
+    }
+
+    // 当前持有的Span总字节数
+    size_t GetBytes() const { return _bytes; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        char* p = AlignUp(_cur, alignment);
+        if (p != nullptr && p <= _end && bytes <= (size_t)(_end - p)) {
+            _cur = p + bytes;
+            return p;
+        }
+
+        const size_t pageSize = (size_t)1 << PAGE_SHIFT;
+        size_t extra = alignment > pageSize ? alignment - pageSize : 0;  // Span只保证按页对齐
+        size_t need = SizeClass::_RoundUp(bytes ? bytes : 1, pageSize) + extra;
+        if (need > (_nextPages << PAGE_SHIFT) / 2) {
+            // 大块：单独一个Span，不替换当前正在切分的Span
+            return AlignUp(NewSpan(need >> PAGE_SHIFT), alignment);
+        }
+
+        char* base = NewSpan(_nextPages);
+        p = AlignUp(base, alignment);
+        _cur = p + bytes;
+        _end = base + (_nextPages << PAGE_SHIFT);
+        if (_nextPages < NPAGES - 1) {
+            _nextPages = _nextPages * 2 < NPAGES - 1 ? _nextPages * 2 : NPAGES - 1;
+        }
+        return p;
+    }
+
+    // 单个释放什么都不做，等Release()一起还
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    static char* AlignUp(char* p, size_t alignment)
+    {
+        return (char*)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    // 向PageCache申请k页的Span，挂到_spans链表头（使用中的Span不在PageCache的任何链表里，_next可以借来用）
+    // Span里的内存只能由Release()整体归还，不能用ConcurrentFree释放
+    // PageCache不清理Span上次使用留下的字段，这里按大内存Span重新设置，页表查到它时不会被当成别的size class或者采样
+    char* NewSpan(size_t k)
+    {
+        Span* span = PageCache::GetInstance()->NewSpan(k);
+        span->_objSize = k << PAGE_SHIFT;
+        span->_freeList = nullptr;
+        span->_sample = nullptr;
+        span->_next = _spans;
+        _spans = span;
+        _bytes += k << PAGE_SHIFT;
+        return (char*)(span->_pageId << PAGE_SHIFT);
+    }
+
+    Span* _spans = nullptr;   // 申请过的所有Span，单链表
+    char* _cur = nullptr;     // 当前Span里还没分配的区域[_cur, _end)
+    char* _end = nullptr;
+    size_t _nextPages;        // 下一个Span的页数
+    size_t _bytes = 0;
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+// NUMA支持 - 按节点划分页堆和中心缓存，线程优先使用本节点的内存
+// 编译时添加 -DENABLE_NUMA 开启（只支持Linux），最多NUMA_MAX_NODES个节点（默认2，双路服务器），
+// 每个节点一组PageCache分片，分片向系统申请的内存用mbind绑定到所属节点；
+// CentralCache/TransferCache也按节点分开，ThreadCache只从自己节点取对象，释放的远端对象还回原节点。
+// 单节点机器上再加 -DNUMA_EMULATE_NODES=N 模拟N个节点：CPU按编号轮流分给各节点，不调用mbind，
+// 只用来测试按节点分配的逻辑
+#include "Common.h"
+#include <string.h>
+
+#if defined(ENABLE_NUMA) && defined(__linux__)
+    #define NUMA_LINUX 1
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#ifndef ENABLE_NUMA
+    #undef NUMA_MAX_NODES
+    #define NUMA_MAX_NODES 1
+#elif !defined(NUMA_MAX_NODES)
+    #define NUMA_MAX_NODES 2
+#endif
+static_assert(NUMA_MAX_NODES >= 1 && NUMA_MAX_NODES <= 64, "NUMA_MAX_NODES取值1~64");
+
+static const size_t NUMA_MAX_CPUS = 1024;  // 支持的最大CPU编号
+
+// 当前线程指定的节点，-1表示按所在CPU决定（inline函数里的静态变量所有编译单元共用一份）
+inline int& NumaThreadNode()
+{
+    static thread_local int node = -1;
+    return node;
+}
+
+// NUMA拓扑 - 单例模式，启动时从/sys读一次节点数和CPU到节点的映射
+class NumaTopology {
+public:
+    static NumaTopology* GetInstance() {
+        static NumaTopology instance;
+        return &instance;
+    }
+
+    // 节点个数（不超过NUMA_MAX_NODES）
+    size_t NodeCount() const { return _nodeCount; }
+
+    // CPU所属的节点
+    size_t NodeOfCpu(size_t cpu) const {
+        return cpu < NUMA_MAX_CPUS ? _cpuToNode[cpu] : 0;
+    }
+
+    // 当前线程所在的节点：指定过就用指定的，否则按当前CPU查表
+    size_t CurrentNode() const {
+#ifdef NUMA_LINUX
+        int node = NumaThreadNode();
+        if (node >= 0) {
+            return node;
+        }
+        int cpu = sched_getcpu();
+        return cpu < 0 ? 0 : NodeOfCpu(cpu);
+#else
+        return 0;
+#endif
+    }
+
+    // 把当前线程固定到一个节点：之后的分配都优先用这个节点的内存
+    // 真实NUMA下同时把线程绑到该节点的CPU上，模拟模式下只记录节点
+    bool BindThread(size_t node) {
+        if (node >= _nodeCount) {
+            return false;
+        }
+#if defined(NUMA_LINUX) && !defined(NUMA_EMULATE_NODES)
+        if (_nodeCount > 1) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (size_t cpu = 0; cpu < NUMA_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu) {
+                if (_cpuOnline[cpu] && _cpuToNode[cpu] == node) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            if (CPU_COUNT(&set) > 0) {
+                sched_setaffinity(0, sizeof(set), &set);
+            }
+        }
+#endif
+        NumaThreadNode() = (int)node;
+        return true;
+    }
+
+    // 刚向系统申请、还没有访问过的内存绑定到节点（MPOL_PREFERRED：节点内存不够时内核可以退到别的节点）
+    void BindMemory(void* ptr, size_t kpage, size_t node) const {
+#if defined(NUMA_LINUX) && !defined(NUMA_EMULATE_NODES)
+        if (_nodeCount > 1) {
+            unsigned long mask = 1UL << node;
+            syscall(SYS_mbind, ptr, kpage << PAGE_SHIFT, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8, 0);
+        }
+#else
+        (void)ptr;
+        (void)kpage;
+        (void)node;
+#endif
+    }
+
+    // 查询一个已经访问过的地址实际在哪个节点的物理内存上，查不到（模拟模式、非Linux）返回-1
+    int PhysicalNodeOf(void* ptr) const {
+#if defined(NUMA_LINUX) && !defined(NUMA_EMULATE_NODES)
+        int node = -1;
+        if (syscall(SYS_get_mempolicy, &node, nullptr, 0, ptr, MPOL_F_NODE_ADDR) == 0) {
+            return node;
+        }
+#else
+        (void)ptr;
+#endif
+        return -1;
+    }
+
+private:
+    // mbind/get_mempolicy用到的常量（不依赖libnuma的numaif.h）
+    static const int MPOL_PREFERRED_MODE = 1;
+    static const int MPOL_F_NODE_ADDR = 1 | 2;  // MPOL_F_NODE | MPOL_F_ADDR
+
+    NumaTopology() {
+        memset(_cpuToNode, 0, sizeof(_cpuToNode));
+#if defined(NUMA_LINUX) && defined(NUMA_EMULATE_NODES)
+        static_assert(NUMA_EMULATE_NODES >= 1 && NUMA_EMULATE_NODES <= NUMA_MAX_NODES,
+                      "模拟的节点数不能超过NUMA_MAX_NODES");
+        _nodeCount = NUMA_EMULATE_NODES;
+        for (size_t cpu = 0; cpu < NUMA_MAX_CPUS; ++cpu) {
+            _cpuToNode[cpu] = (uint8_t)(cpu % NUMA_EMULATE_NODES);
+        }
+#elif defined(NUMA_LINUX)
+        // 节点编号形如"0-1"，超过NUMA_MAX_NODES的节点并到最后一个节点上
+        char buf[256];
+        size_t maxNode = 0;
+        if (ReadFile("/sys/devices/system/node/possible", buf, sizeof(buf))) {
+            ParseList(buf, [&maxNode](size_t node) { maxNode = std::max(maxNode, node); });
+        }
+        _nodeCount = min(maxNode + 1, (size_t)NUMA_MAX_NODES);
+        for (size_t node = 0; node <= maxNode && _nodeCount > 1; ++node) {
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", node);
+            if (!ReadFile(path, buf, sizeof(buf))) {
+                continue;
+            }
+            uint8_t mapped = (uint8_t)min(node, _nodeCount - 1);
+            ParseList(buf, [this, mapped](size_t cpu) {
+                if (cpu < NUMA_MAX_CPUS) {
+                    _cpuToNode[cpu] = mapped;
+                    _cpuOnline[cpu] = true;
+                }
+            });
+        }
+#endif
+    }
+    NumaTopology(const NumaTopology&) = delete;
+    NumaTopology& operator=(const NumaTopology&) = delete;
+
+#ifdef NUMA_LINUX
+    // 直接用系统调用读，不经过stdio（LD_PRELOAD替换malloc时fopen会调用回内存池）
+    static bool ReadFile(const char* path, char* buf, size_t size) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        ssize_t n = read(fd, buf, size - 1);
+        close(fd);
+        if (n <= 0) {
+            return false;
+        }
+        buf[n] = '\0';
+        return true;
+    }
+
+    // 解析"0-3,8-11"这样的编号列表，对每个编号调用f
+    template <class F>
+    static void ParseList(const char* s, F f) {
+        while (*s >= '0' && *s <= '9') {
+            size_t lo = 0;
+            while (*s >= '0' && *s <= '9') {
+                lo = lo * 10 + (*s++ - '0');
+            }
+            size_t hi = lo;
+            if (*s == '-') {
+                ++s;
+                hi = 0;
+                while (*s >= '0' && *s <= '9') {
+                    hi = hi * 10 + (*s++ - '0');
+                }
+            }
+            for (size_t i = lo; i <= hi && i < NUMA_MAX_CPUS; ++i) {
+                f(i);
+            }
+            if (*s == ',') {
+                ++s;
+            }
+        }
+    }
+#endif
+
+    size_t _nodeCount = 1;
+    uint8_t _cpuToNode[NUMA_MAX_CPUS];
+    bool _cpuOnline[NUMA_MAX_CPUS] = {};
+};
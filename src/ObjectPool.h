@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Common.h"
+#include <new>
+
+// 定长对象池：给内存池自己的元数据（Span、ThreadCache）用
+// 1.大块内存直接向系统申请（SystemAlloc），切成定长对象，不依赖malloc/new
+// 2.释放的对象挂到自由链表上，下次优先复用
+// 3.本身不加锁，由使用方保证线程安全（比如Span池在PageCache分片的_pageMtx内使用）
+template <class T>
+class ObjectPool {
+public:
+    T* New() {
+        T* obj = nullptr;
+
+        // 1.优先复用还回来的对象
+        if (_freeList != nullptr) {
+            obj = (T*)_freeList;
+            _freeList = NextObj(_freeList);
+        } else {
+            // 2.剩余内存不够一个对象时，向系统再申请一大块（剩下的零头直接丢弃）
+            if (_remainBytes < OBJ_SIZE) {
+                size_t kpage = (OBJ_SIZE * MIN_OBJ_PER_CHUNK + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+                if (kpage < CHUNK_PAGES) kpage = CHUNK_PAGES;
+                _memory = (char*)SystemAlloc(kpage);
+                _remainBytes = kpage << PAGE_SHIFT;
+            }
+            obj = (T*)_memory;
+            _memory += OBJ_SIZE;
+            _remainBytes -= OBJ_SIZE;
+        }
+
+        // 定位new调用构造函数
+        new (obj) T;
+        return obj;
+    }
+
+    void Delete(T* obj) {
+        // 显式调用析构函数，再头插到自由链表
+        obj->~T();
+        NextObj(obj) = _freeList;
+        _freeList = obj;
+    }
+
+private:
+    // 对象至少要能放下一个指针（挂自由链表），并且按T的对齐要求对齐
+    static constexpr size_t OBJ_SIZE = SizeClass::_RoundUp(
+        sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T), alignof(T));
+    static const size_t CHUNK_PAGES = 16;        // 每次至少向系统申请128KB
+    static const size_t MIN_OBJ_PER_CHUNK = 8;   // 大对象每块也至少能切8个
+
+    char* _memory = nullptr;     // 当前大块内存中还没切分的起始位置
+    size_t _remainBytes = 0;     // 当前大块内存剩余字节数
+    void* _freeList = nullptr;   // 还回来的对象组成的自由链表
+};
@@ -1,170 +1,445 @@
 #include "PageCache.h"
 #include "Common.h"
+#include <chrono>
 
-//实现newSpan函数
-Span* PageCache::NewSpan(size_t k){
-    _pageMtx.lock();
-    //参数检查：1.如果申请的页数大于128页，则直接调用系统接口分配内存
+//空闲时长按毫秒计
+static uint64_t NowMs(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//实现newSpan函数（调用前已经加锁），allowSystem为false时缓存里没有就返回nullptr，不向系统申请
+Span* PageCacheShard::NewSpanLocked(size_t k, bool allowSystem){
+    //参数检查：1.如果申请的页数大于128页，按大内存Span处理
     if(k > 128){
-        //1.直接向OS申请K页
-        void* ptr = SystemAlloc(k);
-        //2.创建一个新的Span对象
-        Span* span = new Span;
-        //3.设置Span的页号以及页数
-        span->_pageId = ((PAGE_ID)ptr) >> PAGE_SHIFT;//将申请到的内存起始地址转换为页号
-        span->_n = k;
-        // //4.将Span对象插入到_spanLists数组中,错误！这里超大页，不需要插入到_spanLists数组中
-        // _spanLists[k].PushFront(span);
-        //5.返回Span对象
-        _pageMtx.unlock();//这里要解锁，因为NewSpan函数是公共接口，可能被多个线程同时调用
-        return span;
+        Span* span = nullptr;
+        if(k > DIRECT_MMAP_PAGES){
+            //1.特别大的内存直接向OS申请K页，释放时直接还给OS，不进缓存
+            void* ptr = SystemAllocOnNode(k);
+            span = _spanPool.New();
+            span->_pageId = ((PAGE_ID)ptr) >> PAGE_SHIFT;//将申请到的内存起始地址转换为页号
+            span->_n = k;
+        }
+        else{
+            //2.先在缓存的大Span里找最合适的，找不到再向OS申请（按一次申请的页数取整），多出来的部分缓存起来
+            Span* nSpan = FindLargeSpan(k);
+            if(nSpan != nullptr){
+                EraseFreeSpan(nSpan);
+            }
+            else{
+                if(!allowSystem){
+                    return nullptr;
+                }
+                size_t npage = (k + SYSTEM_REFILL_PAGES - 1) / SYSTEM_REFILL_PAGES * SYSTEM_REFILL_PAGES;
+                void* ptr = SystemAllocOnNode(npage);
+                nSpan = _spanPool.New();
+                nSpan->_pageId = ((PAGE_ID)ptr) >> PAGE_SHIFT;
+                nSpan->_n = npage;
+                nSpan->_freeTime = NowMs();
+            }
+            span = SplitSpan(nSpan, k);
+        }
+        //3.建立每一页的映射，释放时根据对象地址查找Span
+        return UseSpan(span);
     }
     //2.继续处理正常情况K<=128，注意索引对应，_spanLists[k-1]表示k页的Span链表
     else if(k <= 128 && k > 0){
-        //1.先检查k页的Span链表是否为空
-        if(!_spanLists[k-1].Empty()){
-            //2.如果链表不为空，则从链表中获取一个Span
-            Span* kSpan = _spanLists[k-1].PopFront();
-            //3.建立页号到Span的映射（用于后续页合并）
-            for(size_t i = 0; i < kSpan->_n; ++i){
-                _pageToSpan[kSpan->_pageId + i] = kSpan;
-            }
-            //4.解锁并返回Span对象
-            _pageMtx.unlock();
-            return kSpan;
+        //1.用位图找不少于k页的最小非空链表，不用逐个检查128个链表
+        size_t i = FindNonEmptyList(k);
+        if(i < NPAGES - 1){
+            //2.找到了就取一个Span，正好k页直接用，大了就切出前k页，剩下的挂回对应大小的链表
+            //  比如要3页找到了一个5页，应该把5页的Span切分成3页和2页，3页的Span返回，2页的Span继续处理
+            Span* nSpan = PopFreeSpan(i + 1);
+            //3.标记为使用中并建立页号到Span的映射（CentralCache释放对象时查找Span）
+            //4.返回Span对象
+            return UseSpan(SplitSpan(nSpan, k));
         }
-        //4.如果链表为空，则继续处理
+        //5.如果都为空，则继续处理
         else{
-            //1.如果链表为空，则继续处理
-            //2.从_spanLists[k]开始，找到第一个不为空的Span链表
-            for(size_t i = k; i < 128; ++i){
-                if(!_spanLists[i].Empty()){
-                    //3.如果找到不为空的Span链表，则从链表中获取一个Span
-                    // Span* nSpan = _spanLists[i].PopFront();
-                    // //4.返回Span对象
-                    // return nSpan;这种写法错误
-                    //这里直接返回不对，比如要3页找到了一个5页，应该把5页的Span切分成3页和2页，3页的Span返回，2页的Span继续处理
-                    Span* nSpan = _spanLists[i].PopFront();//获取找到的大页，要切分
-                    Span* kSpan = new Span;
-                    kSpan->_pageId = nSpan->_pageId;
-                    kSpan->_n = k;//设置切分后的小页的kSpan的页号以及页数
-                    nSpan->_pageId += k;//切分后的大页的页号加上k，指向新的大页的起始页号
-                    nSpan->_n -= k;//切分后的大页的页数减去k，指向新的大页的剩余页数
-                    _spanLists[nSpan->_n - 1].PushFront(nSpan);//切分后的小页插入到对应大小的Span链表中
-                    //建立kSpan每一页的映射
-                    for(size_t j = 0; j < kSpan->_n; ++j){
-                        _pageToSpan[kSpan->_pageId + j] = kSpan;
-                    }
-                    _pageMtx.unlock();
-                    return kSpan;
-                }
-                // else{
-                //     //5.如果找到最后一个Span链表，则继续处理，向OS申请128页
-                //     void* ptr = SystemAlloc(128);
-                //     //6.创建一个新的Span对象
-                //     Span* span = new Span;
-                //     //7.设置Span的页号以及页数
-                //     span->_pageId = ((PAGE_ID)ptr) >> PAGE_SHIFT;
-                //     span->_n = 128;
-                //     //8.将Span对象插入到_spanLists数组中
-                //     _spanLists[128].PushFront(span);
-                //     //9.返回Span对象
-                //     return span;
-                // }不应该在循环体内处理，应该在循环体外处理，因为每次有一个空就下来申请一次这逻辑错了
+            //小Span链表都空了，先看有没有缓存的大Span可以切
+            Span* largeSpan = FindLargeSpan(k);
+            if(largeSpan != nullptr){
+                EraseFreeSpan(largeSpan);
+                return UseSpan(SplitSpan(largeSpan, k));
             }
-            // return nullptr;
-            //这里应该继续处理，向OS申请128页
-            void* ptr = SystemAlloc(128);
-            Span* nspan = new Span;//new一个128页的Span对象
-            nspan->_pageId = ((PAGE_ID)ptr) >> PAGE_SHIFT;
-            nspan->_n = 128;
-            //这里仍然需要切分
-            Span* kSpan = new Span;//new一个k页的Span对象
-            kSpan->_pageId = nspan->_pageId;
-            kSpan->_n = k;//设置切分后的小页的kSpan的页号以及页数
-            nspan->_pageId += k;//切分后的大页的页号加上k，指向新的大页的起始页号
-            nspan->_n -= k;//切分后的大页的页数减去k，指向新的大页的剩余页数
-            _spanLists[nspan->_n - 1].PushFront(nspan);//切分后的小页插入到对应大小的Span链表中
-            //建立kSpan每一页的映射
-            for(size_t j = 0; j < kSpan->_n; ++j){
-                _pageToSpan[kSpan->_pageId + j] = kSpan;
+            //这里应该继续处理，向OS申请内存（普通页128页，开启大页时一次申请2MB=256页）
+            if(!allowSystem){
+                return nullptr;
             }
-            _pageMtx.unlock();
-            return kSpan;
+            void* ptr = SystemAllocOnNode(SYSTEM_REFILL_PAGES);
+            PAGE_ID refillId = ((PAGE_ID)ptr) >> PAGE_SHIFT;
+            uint64_t now = NowMs();
+            //超过128页的部分按128页一个Span挂到最大的链表上，供后续申请使用
+            for(size_t j = NPAGES - 1; j < SYSTEM_REFILL_PAGES; j += NPAGES - 1){
+                Span* restSpan = _spanPool.New();
+                restSpan->_pageId = refillId + j;
+                restSpan->_n = NPAGES - 1;
+                restSpan->_freeTime = now;
+                InsertFreeSpan(restSpan);
+            }
+            Span* nspan = _spanPool.New();//从对象池申请一个128页的Span对象
+            nspan->_pageId = refillId;
+            nspan->_n = NPAGES - 1;
+            nspan->_freeTime = now;
+            //这里仍然需要切分（k正好是128页时没有剩余，直接返回整个Span）
+            return UseSpan(SplitSpan(nspan, k));
         }
     }
     //3.如果k<=0，则返回nullptr
     else{
-        _pageMtx.unlock();
         return nullptr;
     }
 }
+
+Span* PageCacheShard::NewSpan(size_t k, bool allowSystem){
+    std::lock_guard<CacheMutex> lock(_pageMtx);
+    return NewSpanLocked(k, allowSystem);
+}
+
+void* PageCacheShard::SystemAllocOnNode(size_t kpage){
+    void* ptr = SystemAlloc(kpage);
+    // 还没有访问过，物理页还没分配，绑定之后第一次访问时就在这个节点上缺页
+    NumaTopology::GetInstance()->BindMemory(ptr, kpage, _node);
+    _systemPages += kpage;
+    return ptr;
+}
+
+//从别的分片偷一个缓存的Span：拿不到锁就算了，不和别的线程抢
+Span* PageCacheShard::TryStealSpan(size_t k){
+    if(!_pageMtx.try_lock()){
+        return nullptr;
+    }
+    Span* span = NewSpanLocked(k, false);
+    _pageMtx.unlock();
+    return span;
+}
+
 //实现ReleaseSpanToPageCache函数
-void PageCache::ReleaseSpanToPageCache(Span* span){
+void PageCacheShard::ReleaseSpanToPageCache(Span* span){
     _pageMtx.lock();
+    _usePages -= span->_n;
+    
+    // 直接mmap的特别大的Span不缓存，直接还给系统
+    if (span->_n > DIRECT_MMAP_PAGES) {
+        void* ptr = (void*)(span->_pageId << PAGE_SHIFT);
+        // 清掉映射，避免这段地址被系统复用后查到已删除的Span
+        _pageToSpan->SetRange(span->_pageId, span->_n, nullptr);
+        SystemFree(ptr, span->_n);
+        _systemPages -= span->_n;
+        _spanPool.Delete(span);
+        _pageMtx.unlock();
+        return;
+    }
+    
+    // 在锁内设置为未使用，否则其他线程合并时可能把还没挂回链表的span当成空闲Span
+    span->_isUse = false;
+    span->_freeTime = NowMs();
+    
+    // 和前后空闲的Span合并
+    span = MergeFreeNeighbors(span);
+    
+    // 将合并后的span插入到对应的SpanList（超过128页的挂到大Span链表）
+    InsertFreeSpan(span);
+    
+    _pageMtx.unlock();
+}
+
+bool PageCacheShard::ResizeSpan(Span* span, size_t k){
+    std::lock_guard<CacheMutex> lock(_pageMtx);
+    // 直接mmap的Span释放时整个还给系统，不能和缓存的页混在一起，调整前后都不能超过阈值
+    if (k == 0 || span->_n > DIRECT_MMAP_PAGES || k > DIRECT_MMAP_PAGES) {
+        return false;
+    }
+    
+    if (k < span->_n) {
+        // 变小：切下尾部，和后面空闲的Span合并后挂回空闲链表
+        Span* tail = _spanPool.New();
+        tail->_pageId = span->_pageId + k;
+        tail->_n = span->_n - k;
+        tail->_freeTime = NowMs();
+        _usePages -= tail->_n;
+        span->_n = k;
+        InsertFreeSpan(MergeFreeNeighbors(tail));
+        return true;
+    }
     
+    // 变大：后面紧挨着的必须是本分片的空闲Span，而且页数够
+    size_t extra = k - span->_n;
+    if (extra == 0) {
+        return true;
+    }
+    Span* nextSpan = _pageToSpan->Get(span->_pageId + span->_n);
+    if (nextSpan == nullptr || !Owns(nextSpan) || nextSpan->_isUse || nextSpan->_n < extra) {
+        return false;
+    }
+    EraseFreeSpan(nextSpan);
+    if (nextSpan->_returned) {
+        _returnedPages -= extra;  // 已还回的页再次访问时内核按需重新分配
+    }
+    if (nextSpan->_n == extra) {
+        _spanPool.Delete(nextSpan);
+    }
+    else {
+        nextSpan->_pageId += extra;
+        nextSpan->_n -= extra;
+        InsertFreeSpan(nextSpan);
+    }
+    _pageToSpan->SetRange(span->_pageId + span->_n, extra, span);
+    span->_n = k;
+    AddUsePages(extra);
+    return true;
+}
+
+// 以下辅助函数都在_pageMtx内调用
+Span* PageCacheShard::MergeFreeNeighbors(Span* span){
     // 向前合并：检查前面的页是否空闲
     while (1) {
         PAGE_ID prevId = span->_pageId - 1;  // 前一页的页号
-        auto it = _pageToSpan.find(prevId);
+        Span* prevSpan = _pageToSpan->Get(prevId);
         
-        // 如果前一页不存在，或者正在使用，停止向前合并
-        if (it == _pageToSpan.end() || it->second->_isUse == true) {
+        // 如果前一页不存在，或者属于别的分片（相邻的两次mmap可能属于不同分片，
+        // 别的分片的Span不在本分片的锁保护下，先判断分片，不能再读其他字段），或者正在使用，停止向前合并
+        if (prevSpan == nullptr || !Owns(prevSpan) || prevSpan->_isUse == true) {
             break;
         }
         
-        Span* prevSpan = it->second;
+        // 已还回和未还回的不合并，否则合并后的Span一部分占着物理内存一部分没有，没法统计也没法整体回收
+        if (prevSpan->_returned != span->_returned) {
+            break;
+        }
         
-        // 合并后的页数超过128，停止合并（超过128页不缓存）
-        if (prevSpan->_n + span->_n > 128) {
+        // 合并后超过直接mmap的阈值，停止合并（缓存的Span不能被当成直接mmap的还给系统）
+        if (prevSpan->_n + span->_n > DIRECT_MMAP_PAGES) {
             break;
         }
         
         // 执行合并：从链表中移除prevSpan
-        _spanLists[prevSpan->_n - 1].Erase(prevSpan);
+        EraseFreeSpan(prevSpan);
         
         // 合并到当前span（扩展当前span向前）
         span->_pageId = prevSpan->_pageId;  // 起始页号变成前一个span的
         span->_n += prevSpan->_n;           // 页数增加
         
-        // 删除prevSpan对象
-        delete prevSpan;
+        // prevSpan对象还给对象池
+        _spanPool.Delete(prevSpan);
     }
     
     // 向后合并：检查后面的页是否空闲
     while (1) {
         PAGE_ID nextId = span->_pageId + span->_n;  // 后一页的页号
-        auto it = _pageToSpan.find(nextId);
+        Span* nextSpan = _pageToSpan->Get(nextId);
         
-        // 如果后一页不存在，或者正在使用，停止向后合并
-        if (it == _pageToSpan.end() || it->second->_isUse == true) {
+        // 如果后一页不存在，或者属于别的分片，或者正在使用，停止向后合并
+        if (nextSpan == nullptr || !Owns(nextSpan) || nextSpan->_isUse == true) {
             break;
         }
         
-        Span* nextSpan = it->second;
+        if (nextSpan->_returned != span->_returned) {
+            break;
+        }
         
-        // 合并后的页数超过128，停止合并
-        if (nextSpan->_n + span->_n > 128) {
+        // 合并后超过直接mmap的阈值，停止合并
+        if (nextSpan->_n + span->_n > DIRECT_MMAP_PAGES) {
             break;
         }
         
         // 执行合并：从链表中移除nextSpan
-        _spanLists[nextSpan->_n - 1].Erase(nextSpan);
+        EraseFreeSpan(nextSpan);
         
         // 合并到当前span（扩展当前span向后）
         span->_n += nextSpan->_n;  // 页数增加（起始页号不变）
         
-        // 删除nextSpan对象
-        delete nextSpan;
+        // nextSpan对象还给对象池
+        _spanPool.Delete(nextSpan);
     }
-    
-    // 建立合并后span的每一页映射
-    for (PAGE_ID i = 0; i < span->_n; ++i) {
-        _pageToSpan[span->_pageId + i] = span;
+    return span;
+}
+
+
+void PageCacheShard::InsertFreeSpan(Span* span){
+    // 发布到页表之前设置分片，别的分片合并时只会看到自己以外的分片号
+    span->_shard.store(_id, std::memory_order_release);
+    FreeSpanList(span->_n).PushFront(span);
+    if (span->_n <= NPAGES - 1) {
+        _listBits[(span->_n - 1) >> 6] |= (uint64_t)1 << ((span->_n - 1) & 63);
+    }
+    // 空闲span只需要映射首尾页，供后续相邻span合并时查找
+    _pageToSpan->Set(span->_pageId, span);
+    _pageToSpan->Set(span->_pageId + span->_n - 1, span);
+}
+
+void PageCacheShard::EraseFreeSpan(Span* span){
+    SpanList& list = FreeSpanList(span->_n);
+    list.Erase(span);
+    // 链表变空了，清掉对应的位
+    if (span->_n <= NPAGES - 1 && list.Empty()) {
+        _listBits[(span->_n - 1) >> 6] &= ~((uint64_t)1 << ((span->_n - 1) & 63));
+    }
+}
+
+Span* PageCacheShard::PopFreeSpan(size_t n){
+    Span* span = _spanLists[n - 1].Begin();
+    EraseFreeSpan(span);
+    return span;
+}
+
+size_t PageCacheShard::FindNonEmptyList(size_t k){
+    // 128个链表对应两个64位字，把下标小于k-1的位屏蔽掉，再取最低位的1
+    size_t start = k - 1;
+    for (size_t w = start >> 6; w < 2; ++w) {
+        uint64_t bits = _listBits[w];
+        if (w == (start >> 6)) {
+            bits &= ~(uint64_t)0 << (start & 63);
+        }
+        if (bits != 0) {
+            return (w << 6) + CountTrailingZeros(bits);
+        }
+    }
+    return NPAGES - 1;
+}
+
+Span* PageCacheShard::FindLargeSpan(size_t k){
+    Span* best = nullptr;
+    for(Span* cur = _largeSpans.Begin(); cur != _largeSpans.End(); cur = cur->_next){
+        if(cur->_n >= k && (best == nullptr || cur->_n < best->_n)){
+            best = cur;
+            if(best->_n == k){
+                break;//正好合适，不用再找了
+            }
+        }
+    }
+    return best;
+}
+
+Span* PageCacheShard::SplitSpan(Span* nSpan, size_t k){
+    if(nSpan->_n == k){
+        return nSpan;
     }
+    Span* kSpan = _spanPool.New();
+    kSpan->_pageId = nSpan->_pageId;
+    kSpan->_n = k;
+    kSpan->_returned = nSpan->_returned;
+    kSpan->_freeTime = nSpan->_freeTime;
+    nSpan->_pageId += k;
+    nSpan->_n -= k;
+    InsertFreeSpan(nSpan);
+    return kSpan;
+}
+
+Span* PageCacheShard::UseSpan(Span* span){
+    // 在锁内标记为使用中，避免其他线程合并时把它当成空闲Span
+    span->_isUse = true;
+    span->_shard.store(_id, std::memory_order_release);
+    _pageToSpan->SetRange(span->_pageId, span->_n, span);
+    AddUsePages(span->_n);
+    // 已还回系统的内存不需要做什么，访问时内核按需重新分配物理页
+    if (span->_returned) {
+        span->_returned = false;
+        _returnedPages -= span->_n;
+    }
+    return span;
+}
+
+size_t PageCacheShard::ReleaseIdleSpans(size_t bytes, uint64_t minIdleMs){
+    std::lock_guard<CacheMutex> lock(_pageMtx);
+    uint64_t now = NowMs();
+    size_t wantPages = bytes == SIZE_MAX ? SIZE_MAX : (bytes + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
     
-    // 将合并后的span插入到对应的SpanList
-    _spanLists[span->_n - 1].PushFront(span);
+    // 1.先挑出要还的Span，从空闲链表摘到临时链表（后面合并会改动空闲链表，不能边遍历边处理）
+    //   从大Span往小Span挑，一次还得越多越划算
+    SpanList victims;
+    size_t picked = 0;
+    for (size_t i = NPAGES; i > 0 && picked < wantPages; --i) {
+        SpanList& list = (i == NPAGES) ? _largeSpans : _spanLists[i - 1];
+        Span* cur = list.Begin();
+        while (cur != list.End() && picked < wantPages) {
+            Span* next = cur->_next;
+            if (!cur->_returned && now - cur->_freeTime >= minIdleMs) {
+                EraseFreeSpan(cur);
+                victims.PushFront(cur);
+                picked += cur->_n;
+            }
+            cur = next;
+        }
+    }
     
-    _pageMtx.unlock();
+    // 2.逐个还给系统，和相邻的已还回Span合并后挂回空闲链表
+    size_t releasedPages = 0;
+    while (!victims.Empty()) {
+        Span* span = victims.PopFront();
+        if (SystemRelease((void*)(span->_pageId << PAGE_SHIFT), span->_n)) {
+            span->_returned = true;
+            _returnedPages += span->_n;
+            releasedPages += span->_n;
+            span = MergeFreeNeighbors(span);
+        }
+        InsertFreeSpan(span);
+    }
+    return releasedPages << PAGE_SHIFT;
+}
+
+// 每个线程在节点内固定用一个分片（轮流分配），大内存和没有指定分片的申请走这里
+size_t PageCache::ThreadShard(){
+    if (PAGE_CACHE_SHARDS == 1) {
+        return 0;
+    }
+    static std::atomic<size_t> next{0};
+    static thread_local size_t shard = next++ % PAGE_CACHE_SHARDS;
+    return shard;
+}
+
+Span* PageCache::NewSpan(size_t k, size_t shard){
+    // 1.先在自己的分片里找缓存的Span
+    Span* span = _shards[shard].NewSpan(k, PAGE_CACHE_SHARDS == 1);
+    if (span != nullptr) {
+        return span;
+    }
+    // 2.自己的分片没有了，试着从同一节点的别的分片偷（拿不到锁的跳过），不跨节点
+    size_t base = shard - shard % PAGE_CACHE_SHARDS;
+    for (size_t i = 1; i < PAGE_CACHE_SHARDS; ++i) {
+        span = _shards[base + (shard + i) % PAGE_CACHE_SHARDS].TryStealSpan(k);
+        if (span != nullptr) {
+            return span;
+        }
+    }
+    // 3.都没有，由自己的分片向系统申请（绑定到本节点）
+    return _shards[shard].NewSpan(k, true);
+}
+
+size_t PageCache::ReleaseIdleSpans(size_t bytes, uint64_t minIdleMs){
+    size_t released = 0;
+    for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS && released < bytes; ++i) {
+        released += _shards[i].ReleaseIdleSpans(bytes - released, minIdleMs);
+    }
+    return released;
+}
+
+void PageCache::StartScavenger(size_t intervalMs, size_t idleMs, size_t bytesPerRound){
+    std::lock_guard<std::mutex> lock(_scavengerMtx);
+    if (_scavenger.joinable()) {
+        return;
+    }
+    _scavengerStop = false;
+    _scavenger = std::thread([this, intervalMs, idleMs, bytesPerRound]() {
+        std::unique_lock<std::mutex> lk(_scavengerMtx);
+        while (!_scavengerCv.wait_for(lk, std::chrono::milliseconds(intervalMs),
+                                      [this]() { return _scavengerStop; })) {
+            lk.unlock();
+            ReleaseIdleSpans(bytesPerRound, idleMs);
+            lk.lock();
+        }
+    });
+}
+
+void PageCache::StopScavenger(){
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(_scavengerMtx);
+        _scavengerStop = true;
+        t = std::move(_scavenger);
+    }
+    _scavengerCv.notify_all();
+    if (t.joinable()) {
+        t.join();
+    }
 }
\ No newline at end of file
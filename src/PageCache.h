@@ -1,24 +1,256 @@
 #pragma once
 
 #include "Common.h"
-#include <unordered_map>
+#include "PageMap.h"
+#include "ObjectPool.h"
+#include "Numa.h"
+#include "LockProfile.h"
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+// 后台回收的默认参数：每隔多久检查一次、空闲多久的Span才还给系统、每轮最多还多少
+static const size_t SCAVENGE_INTERVAL_MS = 1000;
+static const size_t SCAVENGE_IDLE_MS = 5000;
+static const size_t SCAVENGE_BYTES_PER_ROUND = 64 * 1024 * 1024;
+
+// PageCache分片数，默认1个（一把全局锁，和原来一样）
+// 多线程频繁申请/释放Span时锁竞争严重，可以编译时加 -DPAGE_CACHE_SHARDS=8 分成多个分片：
+// 每个分片有自己的锁和空闲链表，管理自己向系统申请的地址范围；页表所有分片共用
+#ifndef PAGE_CACHE_SHARDS
+#define PAGE_CACHE_SHARDS 1
+#endif
+static_assert(PAGE_CACHE_SHARDS >= 1, "PAGE_CACHE_SHARDS至少为1");
+
+// 开启ENABLE_NUMA时每个节点各有PAGE_CACHE_SHARDS个分片，分片号 = 节点号 * PAGE_CACHE_SHARDS + 节点内序号
+static const size_t PAGE_CACHE_TOTAL_SHARDS = NUMA_MAX_NODES * PAGE_CACHE_SHARDS;
+
+// PageCache的一个分片，原来PageCache的全部逻辑都在这里，只是锁和链表按分片各有一份
+// 一个分片只合并自己的Span，Span从哪个分片分配出去就还回哪个分片
+class alignas(64) PageCacheShard{
+public:
+    void Init(uint32_t id, size_t node, PageMap* pageToSpan){
+        _id = id;
+        _node = node;
+        _pageToSpan = pageToSpan;
+    }
+    //申请k页的Span，allowSystem为false时缓存里没有就返回nullptr，不向系统申请
+    Span* NewSpan(size_t k, bool allowSystem);
+    //其他分片缓存不够时来这里取：只try_lock，锁被占着就直接返回nullptr，也不向系统申请
+    Span* TryStealSpan(size_t k);
+    void ReleaseSpanToPageCache(Span* span);
+    //原地把使用中的大内存Span调整为k页：变小时尾部还回缓存，变大时占用紧挨着的空闲页，不够就返回false
+    bool ResizeSpan(Span* span, size_t k);
+    //把空闲超过minIdleMs的未还回Span还给系统，最多bytes字节
+    size_t ReleaseIdleSpans(size_t bytes, uint64_t minIdleMs);
+    //fork前后加解锁分片锁（见PageCache::LockAll）
+    void Lock(){ _pageMtx.lock(); }
+    void Unlock(){ _pageMtx.unlock(); }
+    size_t GetUsePages(){
+        std::lock_guard<CacheMutex> lock(_pageMtx);
+        return _usePages;
+    }
+    size_t GetSystemPages(){
+        std::lock_guard<CacheMutex> lock(_pageMtx);
+        return _systemPages;
+    }
+    size_t GetReturnedPages(){
+        std::lock_guard<CacheMutex> lock(_pageMtx);
+        return _returnedPages;
+    }
+    size_t GetPeakUsePages(){
+        std::lock_guard<CacheMutex> lock(_pageMtx);
+        return _peakUsePages;
+    }
+#ifdef ENABLE_LOCK_PROFILE
+    const LockCounters& GetLockCounters() const{
+        return _pageMtx.Counters();
+    }
+#endif
+
+private:
+    //NewSpan的实现，调用前已经持有_pageMtx
+    Span* NewSpanLocked(size_t k, bool allowSystem);
+    //向系统申请kpage页并绑定到本分片所属的NUMA节点
+    void* SystemAllocOnNode(size_t kpage);
+    //空闲Span按页数挂到对应的链表：128页以内按页数挂到_spanLists，超过128页挂到_largeSpans
+    SpanList& FreeSpanList(size_t n){
+        return n <= NPAGES - 1 ? _spanLists[n - 1] : _largeSpans;
+    }
+    //空闲Span挂回链表，并映射首尾页供相邻Span合并时查找
+    void InsertFreeSpan(Span* span);
+    //空闲Span从链表摘下；取出n页链表的第一个Span（调用前链表不能为空）
+    //空闲链表的增删都要经过InsertFreeSpan/EraseFreeSpan，保证位图和链表一致
+    void EraseFreeSpan(Span* span);
+    Span* PopFreeSpan(size_t n);
+    //用位图找不少于k页的最小非空链表下标（_spanLists[i]，i+1页），都为空返回NPAGES-1
+    size_t FindNonEmptyList(size_t k);
+    //在_largeSpans里找不少于k页的最小Span（best-fit），没有返回nullptr
+    Span* FindLargeSpan(size_t k);
+    //从已经摘下来的空闲Span切出前k页返回，剩余部分挂回空闲链表
+    Span* SplitSpan(Span* nSpan, size_t k);
+    //标记为使用中并映射每一页，返回给调用者
+    Span* UseSpan(Span* span);
+    //已分配出去的页数增加k页，顺便更新峰值
+    void AddUsePages(size_t k){
+        _usePages += k;
+        if (_usePages > _peakUsePages) {
+            _peakUsePages = _usePages;
+        }
+    }
+    //页表查到的相邻Span是不是本分片的：是才能在本分片的锁内读它的其他字段，别的分片的Span只能读_shard
+    bool Owns(Span* span) const{
+        return span->_shard.load(std::memory_order_acquire) == _id;
+    }
+    //和前后相邻的空闲Span合并（只合并本分片的、同样是已还回/未还回的），返回合并后的Span，调用前span不在链表里
+    Span* MergeFreeNeighbors(Span* span);
+
+    SpanList _spanLists[NPAGES];//按页大小映射的Span双向链表数组
+    uint64_t _listBits[2] = {0, 0};//_spanLists的非空位图，第i位为1表示_spanLists[i]非空
+    SpanList _largeSpans;//超过128页的空闲Span，数量不多，用一个链表按best-fit查找
+    CacheMutex _pageMtx;//分片锁，保护本分片的并发访问
+    PageMap* _pageToSpan = nullptr;//所有分片共用的页表
+    uint32_t _id = 0;//分片编号
+    size_t _node = 0;//所属的NUMA节点
+    size_t _usePages = 0;//已分配出去的页数，在_pageMtx内更新
+    size_t _peakUsePages = 0;//_usePages的峰值，在_pageMtx内更新
+    size_t _systemPages = 0;//向系统申请的总页数，在_pageMtx内更新
+    size_t _returnedPages = 0;//空闲并且已经还给系统的页数，在_pageMtx内更新
+    ObjectPool<Span> _spanPool;//Span对象池，在_pageMtx内使用，不依赖malloc
+};
+
 class PageCache{//单例模式
 public:
     static PageCache* GetInstance(){
         static PageCache _sInst;
         return &_sInst;
     }
-    //接口一：当CentralCache没有内存时，向PageCache申请内存
-    Span* NewSpan(size_t k);//参数，需要多少页，k=页数
+    //接口一：当CentralCache没有内存时，向PageCache申请内存，默认用当前线程所在NUMA节点的分片
+    Span* NewSpan(size_t k){//参数，需要多少页，k=页数
+        return NewSpanOnNode(k, NumaTopology::GetInstance()->CurrentNode());
+    }
+    //从指定NUMA节点的分片申请
+    Span* NewSpanOnNode(size_t k, size_t node){
+        return NewSpan(k, node * PAGE_CACHE_SHARDS + ThreadShard());
+    }
+    //指定优先使用的分片（CentralCache按size class分散到各分片），自己的分片没有缓存时先从同一节点的别的分片取
+    Span* NewSpan(size_t k, size_t shard);
+    //Span所属的NUMA节点
+    static size_t NodeOf(Span* span){
+        return span->_shard / PAGE_CACHE_SHARDS;
+    }
     //接口二：当ThreadCache释放内存时，向PageCache释放内存
-    void ReleaseSpanToPageCache(Span* span);//参数，要释放的Span
+    void ReleaseSpanToPageCache(Span* span){//参数，要释放的Span
+        _shards[span->_shard].ReleaseSpanToPageCache(span);
+    }
+    //原地调整大内存Span的页数（realloc用），Span地址不变，调整不了返回false
+    bool ResizeSpan(Span* span, size_t k){
+        return _shards[span->_shard].ResizeSpan(span, k);
+    }
+    //接口三：根据对象地址找到所属的Span，CentralCache和PageCache共用一张页表，读操作无锁
+    Span* MapObjectToSpan(void* obj){
+        PAGE_ID pageId = ((PAGE_ID)obj) >> PAGE_SHIFT;
+        return _pageToSpan.Get(pageId);
+    }
+    //接口四：已经分配出去（给CentralCache或大内存）的页数，用于观察内存占用
+    size_t GetUsePages(){
+        size_t pages = 0;
+        for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+            pages += _shards[i].GetUsePages();
+        }
+        return pages;
+    }
+    //某个NUMA节点已经分配出去的页数
+    size_t GetNodeUsePages(size_t node){
+        size_t pages = 0;
+        for (size_t i = 0; i < PAGE_CACHE_SHARDS; ++i) {
+            pages += _shards[node * PAGE_CACHE_SHARDS + i].GetUsePages();
+        }
+        return pages;
+    }
+    //接口五：把空闲Span的物理内存还给系统（madvise），最多还bytes字节，返回实际还了多少字节
+    //地址空间保留，Span标记为已还回，再次分配出去时按需重新缺页
+    size_t ReleaseFreeMemory(size_t bytes = SIZE_MAX){
+        return ReleaseIdleSpans(bytes, 0);
+    }
+    //接口六：后台回收线程，每intervalMs检查一次，把空闲超过idleMs的Span还给系统，每轮最多bytesPerRound字节
+    void StartScavenger(size_t intervalMs = SCAVENGE_INTERVAL_MS, size_t idleMs = SCAVENGE_IDLE_MS,
+                        size_t bytesPerRound = SCAVENGE_BYTES_PER_ROUND);
+    void StopScavenger();
+    //接口七：向系统申请的总页数，以及其中空闲并且已经还给系统的页数
+    //实际占用（已提交）的页数 = 总页数 - 已还回页数
+    size_t GetSystemPages(){
+        size_t pages = 0;
+        for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+            pages += _shards[i].GetSystemPages();
+        }
+        return pages;
+    }
+    size_t GetReturnedPages(){
+        size_t pages = 0;
+        for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+            pages += _shards[i].GetReturnedPages();
+        }
+        return pages;
+    }
+    //已分配出去的页数的峰值：每个分片各自记录峰值再相加，只有一个分片时是准确值，多个分片时是上界
+    size_t GetPeakUsePages(){
+        size_t pages = 0;
+        for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+            pages += _shards[i].GetPeakUsePages();
+        }
+        return pages;
+    }
+    //接口八：fork前拿住PageCache的所有锁，fork后在父子进程里各自释放（MallocOverride.cpp注册pthread_atfork）
+    //分片锁按分片号依次拿，页表的_growMtx只在分片锁内才会拿，放在最后
+    void LockAll(){
+        for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+            _shards[i].Lock();
+        }
+        _pageToSpan.LockGrow();
+    }
+    void UnlockAll(){
+        _pageToSpan.UnlockGrow();
+        for (size_t i = PAGE_CACHE_TOTAL_SHARDS; i > 0; --i) {
+            _shards[i - 1].Unlock();
+        }
+    }
+    //回收线程的锁：持有它时会创建线程（间接申请内存），要在内存池其他锁之前拿
+    void LockScavenger(){ _scavengerMtx.lock(); }
+    void UnlockScavenger(){ _scavengerMtx.unlock(); }
+    //子进程里只有调用fork的线程，回收线程不存在了：丢掉句柄（不能join），需要的话在子进程里重新StartScavenger
+    void ResetAfterFork(){
+        if (_scavenger.joinable()) {
+            _scavenger.detach();
+        }
+    }
+#ifdef ENABLE_LOCK_PROFILE
+    //某个分片的锁的竞争统计（开启ENABLE_NUMA时分片号 = 节点号 * PAGE_CACHE_SHARDS + 节点内序号）
+    const LockCounters& GetLockCounters(size_t shard) const{
+        return _shards[shard].GetLockCounters();
+    }
+#endif
 
 private:
-    PageCache(){}//构造函数私有化防止外部构造
+    PageCache(){//构造函数私有化防止外部构造
+        for (uint32_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+            _shards[i].Init(i, i / PAGE_CACHE_SHARDS, &_pageToSpan);
+        }
+    }
+    ~PageCache(){ StopScavenger(); }
     PageCache(const PageCache&)=delete;//禁止拷贝构造
     PageCache& operator=(const PageCache&)=delete;//禁止赋值
-    SpanList _spanLists[NPAGES];//按页大小映射的Span双向链表数组
-    std::mutex _pageMtx;//全局锁，保护PageCache的并发访问
-    std::unordered_map<PAGE_ID, Span*> _pageToSpan;//页号到Span的映射
-};
\ No newline at end of file
+    //当前线程在一个节点内默认使用的分片序号，线程第一次用时轮流分配
+    static size_t ThreadShard();
+    //依次让每个分片把空闲超过minIdleMs的Span还给系统，总共最多bytes字节
+    size_t ReleaseIdleSpans(size_t bytes, uint64_t minIdleMs);
+
+    PageMap _pageToSpan;//页号到Span的映射（基数树），所有分片共用
+    PageCacheShard _shards[PAGE_CACHE_TOTAL_SHARDS];
+
+    std::thread _scavenger;//后台回收线程
+    std::mutex _scavengerMtx;
+    std::condition_variable _scavengerCv;
+    bool _scavengerStop = false;
+};
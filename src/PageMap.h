@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Common.h"
+#include <atomic>
+#include <mutex>
+#include <string.h>
+
+// 页号 -> Span* 的基数树（参考TCMalloc的PageMap2/PageMap3）
+// 取代原来的unordered_map：
+//   1.插入不需要为每个节点new一次，也不会rehash
+//   2.读操作不加锁：节点只会新增不会删除；一段页号只由管理它的PageCache分片在分片锁内写，
+//     分片之间只会同时新增树节点，由_growMtx保护
+//   3.树节点直接向系统申请（SystemAlloc），不依赖malloc
+
+// 两层基数树：适合32位地址空间，根节点直接放在对象里
+template <int BITS>
+class PageMap2 {
+private:
+    static const int ROOT_BITS = 5;
+    static const int ROOT_LENGTH = 1 << ROOT_BITS;
+    static const int LEAF_BITS = BITS - ROOT_BITS;
+    static const int LEAF_LENGTH = 1 << LEAF_BITS;
+
+    struct Leaf {
+        std::atomic<Span*> values[LEAF_LENGTH];
+    };
+
+    std::atomic<Leaf*> _root[ROOT_LENGTH];
+    std::mutex _growMtx;  // 新增树节点时加锁
+
+public:
+    PageMap2() {
+        memset((void*)_root, 0, sizeof(_root));
+    }
+
+    // fork前后加解锁（见MallocOverride.cpp），保证子进程里_growMtx不是被别的线程拿着的状态
+    void LockGrow() { _growMtx.lock(); }
+    void UnlockGrow() { _growMtx.unlock(); }
+
+    // 查找页号对应的Span，没有映射返回nullptr（无锁）
+    Span* Get(PAGE_ID id) const {
+        if ((id >> BITS) > 0)
+            return nullptr;
+        Leaf* leaf = _root[id >> LEAF_BITS].load(std::memory_order_acquire);
+        if (leaf == nullptr)
+            return nullptr;
+        return leaf->values[id & (LEAF_LENGTH - 1)].load(std::memory_order_acquire);
+    }
+
+    // 建立映射，调用方需要持有管理这段页号的PageCache分片的锁
+    void Set(PAGE_ID id, Span* span) {
+        assert((id >> BITS) == 0);
+        Ensure(id, 1);
+        Leaf* leaf = _root[id >> LEAF_BITS].load(std::memory_order_acquire);
+        leaf->values[id & (LEAF_LENGTH - 1)].store(span, std::memory_order_release);
+    }
+
+    // 把[start, start+n)这段页号都映射到span，每个叶子只定位一次（大Span有几百上千页）
+    void SetRange(PAGE_ID start, size_t n, Span* span) {
+        assert(((start + n - 1) >> BITS) == 0);
+        Ensure(start, n);
+        for (PAGE_ID key = start; key < start + n;) {
+            Leaf* leaf = _root[key >> LEAF_BITS].load(std::memory_order_acquire);
+            PAGE_ID last = min((PAGE_ID)(start + n), ((key >> LEAF_BITS) + 1) << LEAF_BITS);
+            for (; key < last; ++key) {
+                leaf->values[key & (LEAF_LENGTH - 1)].store(span, std::memory_order_release);
+            }
+        }
+    }
+
+    // 保证[start, start+n)这段页号的树节点都已经分配
+    void Ensure(PAGE_ID start, size_t n) {
+        for (PAGE_ID key = start; key < start + n;) {
+            PAGE_ID i1 = key >> LEAF_BITS;
+            assert(i1 < (PAGE_ID)ROOT_LENGTH);
+            if (_root[i1].load(std::memory_order_acquire) == nullptr) {
+                std::lock_guard<std::mutex> lock(_growMtx);
+                if (_root[i1].load(std::memory_order_relaxed) == nullptr) {
+                    // SystemAlloc返回的内存已经清零，相当于全部是nullptr
+                    Leaf* leaf = (Leaf*)SystemAlloc(PagesOf(sizeof(Leaf)));
+                    _root[i1].store(leaf, std::memory_order_release);
+                }
+            }
+            key = ((key >> LEAF_BITS) + 1) << LEAF_BITS;  // 跳到下一个叶子
+        }
+    }
+
+private:
+    static size_t PagesOf(size_t bytes) {
+        return (bytes + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+    }
+};
+
+// 三层基数树：适合64位（48位有效地址）空间，只为用到的地址段分配中间节点和叶子
+template <int BITS>
+class PageMap3 {
+private:
+    static const int INTERIOR_BITS = (BITS + 2) / 3;  // 向上取整
+    static const int INTERIOR_LENGTH = 1 << INTERIOR_BITS;
+    static const int LEAF_BITS = BITS - 2 * INTERIOR_BITS;
+    static const int LEAF_LENGTH = 1 << LEAF_BITS;
+
+    struct Leaf {
+        std::atomic<Span*> values[LEAF_LENGTH];
+    };
+
+    struct Node {
+        std::atomic<Leaf*> leafs[INTERIOR_LENGTH];
+    };
+
+    std::atomic<Node*> _root[INTERIOR_LENGTH];
+    std::mutex _growMtx;  // 新增树节点时加锁
+
+public:
+    PageMap3() {
+        memset((void*)_root, 0, sizeof(_root));
+    }
+
+    // fork前后加解锁（见MallocOverride.cpp），保证子进程里_growMtx不是被别的线程拿着的状态
+    void LockGrow() { _growMtx.lock(); }
+    void UnlockGrow() { _growMtx.unlock(); }
+
+    // 查找页号对应的Span，没有映射返回nullptr（无锁）
+    Span* Get(PAGE_ID id) const {
+        if ((id >> BITS) > 0)
+            return nullptr;
+        const PAGE_ID i1 = id >> (LEAF_BITS + INTERIOR_BITS);
+        const PAGE_ID i2 = (id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+        const PAGE_ID i3 = id & (LEAF_LENGTH - 1);
+        Node* node = _root[i1].load(std::memory_order_acquire);
+        if (node == nullptr)
+            return nullptr;
+        Leaf* leaf = node->leafs[i2].load(std::memory_order_acquire);
+        if (leaf == nullptr)
+            return nullptr;
+        return leaf->values[i3].load(std::memory_order_acquire);
+    }
+
+    // 建立映射，调用方需要持有管理这段页号的PageCache分片的锁
+    void Set(PAGE_ID id, Span* span) {
+        assert((id >> BITS) == 0);
+        Ensure(id, 1);
+        const PAGE_ID i1 = id >> (LEAF_BITS + INTERIOR_BITS);
+        const PAGE_ID i2 = (id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+        const PAGE_ID i3 = id & (LEAF_LENGTH - 1);
+        Leaf* leaf = _root[i1].load(std::memory_order_acquire)->leafs[i2].load(std::memory_order_acquire);
+        leaf->values[i3].store(span, std::memory_order_release);
+    }
+
+    // 把[start, start+n)这段页号都映射到span，每个叶子只定位一次（大Span有几百上千页）
+    void SetRange(PAGE_ID start, size_t n, Span* span) {
+        assert(((start + n - 1) >> BITS) == 0);
+        Ensure(start, n);
+        for (PAGE_ID key = start; key < start + n;) {
+            const PAGE_ID i1 = key >> (LEAF_BITS + INTERIOR_BITS);
+            const PAGE_ID i2 = (key >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+            Leaf* leaf = _root[i1].load(std::memory_order_acquire)->leafs[i2].load(std::memory_order_acquire);
+            PAGE_ID last = min((PAGE_ID)(start + n), ((key >> LEAF_BITS) + 1) << LEAF_BITS);
+            for (; key < last; ++key) {
+                leaf->values[key & (LEAF_LENGTH - 1)].store(span, std::memory_order_release);
+            }
+        }
+    }
+
+    // 保证[start, start+n)这段页号的树节点都已经分配
+    void Ensure(PAGE_ID start, size_t n) {
+        for (PAGE_ID key = start; key < start + n;) {
+            const PAGE_ID i1 = key >> (LEAF_BITS + INTERIOR_BITS);
+            const PAGE_ID i2 = (key >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+            assert(i1 < (PAGE_ID)INTERIOR_LENGTH);
+
+            Node* node = _root[i1].load(std::memory_order_acquire);
+            if (node == nullptr || node->leafs[i2].load(std::memory_order_acquire) == nullptr) {
+                // 不同分片可能同时新增同一个节点，加锁后再检查一次
+                std::lock_guard<std::mutex> lock(_growMtx);
+                node = _root[i1].load(std::memory_order_relaxed);
+                if (node == nullptr) {
+                    // SystemAlloc返回的内存已经清零，相当于全部是nullptr
+                    node = (Node*)SystemAlloc(PagesOf(sizeof(Node)));
+                    _root[i1].store(node, std::memory_order_release);
+                }
+                if (node->leafs[i2].load(std::memory_order_relaxed) == nullptr) {
+                    Leaf* leaf = (Leaf*)SystemAlloc(PagesOf(sizeof(Leaf)));
+                    node->leafs[i2].store(leaf, std::memory_order_release);
+                }
+            }
+            key = ((key >> LEAF_BITS) + 1) << LEAF_BITS;  // 跳到下一个叶子
+        }
+    }
+
+private:
+    static size_t PagesOf(size_t bytes) {
+        return (bytes + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+    }
+};
+
+// 64位按48位有效地址计算页号位数，32位直接用整个地址空间
+#if defined(_WIN64) || defined(__x86_64__) || defined(__aarch64__) || (defined(__SIZEOF_POINTER__) && __SIZEOF_POINTER__ == 8)
+typedef PageMap3<48 - PAGE_SHIFT> PageMap;
+#else
+typedef PageMap2<32 - PAGE_SHIFT> PageMap;
+#endif
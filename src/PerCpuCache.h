@@ -0,0 +1,437 @@
+#pragma once
+
+// per-CPU缓存 - 可选的小对象前端，替代ThreadCache
+// 编译时添加 -DENABLE_PERCPU 开启（目前只支持Linux x86_64）
+//
+// 线程数远多于CPU核数时，每个ThreadCache都各自缓存对象，内存按线程数成倍放大，空闲线程的缓存还是冷的。
+// per-CPU缓存按CPU而不是按线程缓存对象：每个CPU每个size class一个槽位（对象指针数组）。
+// 用Linux的restartable sequences（rseq）保证一段代码在同一个CPU上不被打断地执行完，
+// 被抢占、迁移或者来信号时内核会让它跳到abort重来，所以push/pop不需要锁也不需要原子指令。
+// rseq不可用（内核太老、非x86_64）时退回到ThreadCache。
+#include "Common.h"
+#include "ThreadCache.h"
+
+#if defined(ENABLE_PERCPU) && defined(__linux__) && defined(__x86_64__)
+    #define PERCPU_RSEQ 1
+    #include <sys/syscall.h>
+    #include <sched.h>
+    #include <unistd.h>
+    #include <stdint.h>
+    #if __has_include(<sys/rseq.h>)
+        #include <sys/rseq.h>   // glibc 2.35+ 已经替每个线程注册好了rseq，导出__rseq_offset/__rseq_size
+    #endif
+#endif
+
+#ifdef PERCPU_RSEQ
+
+static const size_t PERCPU_MAX_CPUS = 1024;          // 支持的最大CPU编号
+static const size_t PERCPU_SLOT_CAPACITY = 128;      // 每个槽位最多缓存的对象个数
+static const size_t PERCPU_SLOT_BYTES = 64 * 1024;   // 每个槽位最多缓存的字节数（大对象少缓存）
+static const uint32_t RSEQ_SIGNATURE = 0x53053053;   // x86上abort入口前的签名，和glibc一致
+
+// 内核rseq结构体（只用到前几个字段），要求32字节对齐
+struct alignas(32) RseqArea {
+    uint32_t _cpuIdStart;
+    uint32_t _cpuId;        // 当前线程所在的CPU，内核负责更新
+    uint64_t _rseqCs;       // 当前临界区描述符的地址
+    uint32_t _flags;
+    uint32_t _padding[3];
+};
+
+// 一个CPU上一个size class的缓存槽位
+// 布局被下面的汇编直接使用：_count偏移0，_cap偏移8，_objs偏移16
+struct PerCpuSlot {
+    size_t _count;                        // 当前缓存的对象个数，rseq的提交点就是对它的写入
+    size_t _cap;                          // 容量
+    void* _objs[PERCPU_SLOT_CAPACITY];    // 对象指针栈
+};
+
+struct PerCpuSlab {
+    PerCpuSlot _slots[NFREELIST];
+};
+
+// 获取当前线程的rseq区域：glibc注册过就直接用，否则自己注册一次
+static inline RseqArea* CurrentRseq()
+{
+#if defined(__GLIBC__) && defined(RSEQ_SIG)
+    if (__rseq_size > 0) {
+        return (RseqArea*)((char*)__builtin_thread_pointer() + __rseq_offset);
+    }
+#endif
+    static thread_local RseqArea area;
+    static thread_local int state = 0;  // 0未注册，1成功，-1失败
+    if (state == 0) {
+        state = syscall(__NR_rseq, &area, sizeof(area), 0, RSEQ_SIGNATURE) == 0 ? 1 : -1;
+    }
+    return state == 1 ? &area : nullptr;
+}
+
+// rseq临界区：从当前CPU的槽位弹出一个对象
+// 返回0成功；1槽位为空或者当前CPU还没有slab（走慢路径）；-1被内核打断（重试）
+static inline int RseqPop(RseqArea* rs, PerCpuSlab** slabs, size_t slotOffset, void** out)
+{
+    asm volatile goto(
+        // 临界区描述符：版本、标志、起始地址、提交点偏移、abort入口
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0x0, 0x0\n\t"
+        ".quad 1f, (2f - 1f), 4f\n\t"
+        ".popsection\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %[rseq_cs]\n\t"
+        "1:\n\t"
+        "movl %[cpu_id], %%eax\n\t"              // eax = 当前CPU
+        "cmpl %[max_cpus], %%eax\n\t"
+        "jae %l[fail]\n\t"
+        "movq (%[slabs], %%rax, 8), %%rax\n\t"   // rax = slabs[cpu]
+        "testq %%rax, %%rax\n\t"
+        "jz %l[fail]\n\t"
+        "addq %[offset], %%rax\n\t"              // rax = 槽位
+        "movq (%%rax), %%rcx\n\t"                // rcx = _count
+        "testq %%rcx, %%rcx\n\t"
+        "jz %l[fail]\n\t"
+        "movq 8(%%rax, %%rcx, 8), %%rdx\n\t"     // rdx = _objs[_count - 1]
+        "decq %%rcx\n\t"
+        "movq %%rcx, (%%rax)\n\t"                // 提交：_count - 1
+        "2:\n\t"
+        "movq %%rdx, (%[out])\n\t"
+        // abort入口，前面4字节是签名
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t"
+        ".long 0x53053053\n\t"
+        "4:\n\t"
+        "jmp %l[abort]\n\t"
+        ".popsection\n\t"
+        :
+        : [rseq_cs] "m"(rs->_rseqCs), [cpu_id] "m"(rs->_cpuId),
+          [max_cpus] "i"(PERCPU_MAX_CPUS), [slabs] "r"(slabs),
+          [offset] "r"(slotOffset), [out] "r"(out)
+        : "memory", "cc", "rax", "rcx", "rdx"
+        : fail, abort);
+    return 0;
+fail:
+    return 1;
+abort:
+    return -1;
+}
+
+// rseq临界区：把一个对象压入当前CPU的槽位
+// 返回0成功；1槽位已满或者当前CPU还没有slab（走慢路径）；-1被内核打断（重试）
+static inline int RseqPush(RseqArea* rs, PerCpuSlab** slabs, size_t slotOffset, void* obj)
+{
+    asm volatile goto(
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0x0, 0x0\n\t"
+        ".quad 1f, (2f - 1f), 4f\n\t"
+        ".popsection\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %[rseq_cs]\n\t"
+        "1:\n\t"
+        "movl %[cpu_id], %%eax\n\t"
+        "cmpl %[max_cpus], %%eax\n\t"
+        "jae %l[fail]\n\t"
+        "movq (%[slabs], %%rax, 8), %%rax\n\t"
+        "testq %%rax, %%rax\n\t"
+        "jz %l[fail]\n\t"
+        "addq %[offset], %%rax\n\t"
+        "movq (%%rax), %%rcx\n\t"                // rcx = _count
+        "cmpq 8(%%rax), %%rcx\n\t"               // _count >= _cap 表示满了
+        "jae %l[fail]\n\t"
+        "movq %[obj], 16(%%rax, %%rcx, 8)\n\t"   // _objs[_count] = obj（提交前被打断也无害）
+        "incq %%rcx\n\t"
+        "movq %%rcx, (%%rax)\n\t"                // 提交：_count + 1
+        "2:\n\t"
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t"
+        ".long 0x53053053\n\t"
+        "4:\n\t"
+        "jmp %l[abort]\n\t"
+        ".popsection\n\t"
+        :
+        : [rseq_cs] "m"(rs->_rseqCs), [cpu_id] "m"(rs->_cpuId),
+          [max_cpus] "i"(PERCPU_MAX_CPUS), [slabs] "r"(slabs),
+          [offset] "r"(slotOffset), [obj] "r"(obj)
+        : "memory", "cc", "rax", "rcx"
+        : fail, abort);
+    return 0;
+fail:
+    return 1;
+abort:
+    return -1;
+}
+
+// per-CPU缓存 - 单例模式
+class PerCpuCache {
+public:
+    static PerCpuCache* GetInstance() {
+        static PerCpuCache instance;
+        return &instance;
+    }
+
+    void* Allocate(size_t size)
+    {
+        size_t index = SizeClass::Index(size);
+        RseqArea* rs = CurrentRseq();
+        if (rs == nullptr) {
+            return GetTLSThreadCache()->Allocate(size);
+        }
+
+        void* obj = nullptr;
+        int ret;
+        while ((ret = RseqPop(rs, _slabs, index * sizeof(PerCpuSlot), &obj)) < 0) {
+        }
+        if (ret == 0) {
+            Stats(index).allocs.Add(1);
+            return obj;
+        }
+        return AllocateSlow(rs, index, size);
+    }
+
+    void Deallocate(void* ptr, size_t size)
+    {
+        size_t index = SizeClass::Index(size);
+        RseqArea* rs = CurrentRseq();
+        if (rs == nullptr) {
+            GetTLSThreadCache()->Deallocate(ptr, size);
+            return;
+        }
+
+        int ret;
+        while ((ret = RseqPush(rs, _slabs, index * sizeof(PerCpuSlot), ptr)) < 0) {
+        }
+        if (ret != 0) {
+            DeallocateSlow(rs, index, ptr, size);
+            return;
+        }
+        Stats(index).frees.Add(1);
+    }
+
+    // 清空所有CPU的槽位，对象还回CentralCache（测试检查Span全部还回PageCache时用，代价很高，不要放在分配路径上）
+    // 槽位只能由所在CPU上的rseq临界区修改，所以把当前线程依次绑到每个有slab的CPU上弹空它的槽位，最后恢复原来的CPU亲和性
+    // 有CPU绑不上（不在本线程允许的CPU集合里）时跳过它，返回false
+    bool Drain()
+    {
+        RseqArea* rs = CurrentRseq();
+        if (rs == nullptr) {
+            return true;  // rseq不可用，从来没用过槽位
+        }
+        cpu_set_t old;
+        if (sched_getaffinity(0, sizeof(old), &old) != 0) {
+            return false;
+        }
+        bool drained = true;
+        for (uint32_t cpu = 0; cpu < PERCPU_MAX_CPUS; ++cpu) {
+            if (__atomic_load_n(&_slabs[cpu], __ATOMIC_ACQUIRE) == nullptr) {
+                continue;
+            }
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            if (sched_setaffinity(0, sizeof(one), &one) != 0) {
+                drained = false;
+                continue;
+            }
+            for (size_t index = 0; index < NFREELIST; ++index) {
+                DrainSlot(rs, index);
+            }
+            drained = drained && __atomic_load_n(&rs->_cpuId, __ATOMIC_RELAXED) == cpu;
+        }
+        sched_setaffinity(0, sizeof(old), &old);
+        return drained;
+    }
+
+    // fork前后加解锁slab创建的锁（见MallocOverride.cpp）；槽位本身没有锁，每次修改都是一次提交，fork时不会停在一半
+    void LockInit() { _initMtx.lock(); }
+    void UnlockInit() { _initMtx.unlock(); }
+
+private:
+    PerCpuCache()
+    {
+        // 按对象大小计算每个size class槽位的容量：小对象最多PERCPU_SLOT_CAPACITY个，大对象按字节数限制，至少1个
+        for (size_t i = 0; i < NFREELIST; ++i) {
+            size_t cap = PERCPU_SLOT_BYTES / SizeClass::Size(i);
+            if (cap > PERCPU_SLOT_CAPACITY) cap = PERCPU_SLOT_CAPACITY;
+            if (cap < 1) cap = 1;
+            _caps[i] = cap;
+        }
+    }
+    PerCpuCache(const PerCpuCache&) = delete;
+    PerCpuCache& operator=(const PerCpuCache&) = delete;
+
+    // 统计记在当前线程的ThreadStats里（槽位按CPU共享，没法按CPU只让一个线程写）
+    static ClassStats& Stats(size_t index)
+    {
+        return GetThreadStats()->classes[index];
+    }
+
+    // 第一次在某个CPU上使用时创建它的slab
+    bool EnsureSlab(uint32_t cpu)
+    {
+        if (cpu >= PERCPU_MAX_CPUS) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(_initMtx);
+        if (_slabs[cpu] == nullptr) {
+            size_t kpage = (sizeof(PerCpuSlab) + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+            PerCpuSlab* slab = (PerCpuSlab*)SystemAlloc(kpage);  // 已清零，_count都是0
+            for (size_t i = 0; i < NFREELIST; ++i) {
+                slab->_slots[i]._cap = _caps[i];
+            }
+            __atomic_store_n(&_slabs[cpu], slab, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+    // 当前CPU槽位为空：向CentralCache批量申请，一个返回，其余压入槽位
+    void* AllocateSlow(RseqArea* rs, size_t index, size_t size)
+    {
+        uint32_t cpu = rs->_cpuId;
+        if (cpu < PERCPU_MAX_CPUS && _slabs[cpu] == nullptr) {
+            EnsureSlab(cpu);
+            return Allocate(size);
+        }
+        if (cpu >= PERCPU_MAX_CPUS) {
+            return GetTLSThreadCache()->Allocate(size);
+        }
+
+        size_t alignSize = SizeClass::Size(index);
+        size_t batchNum = _caps[index] / 2 + 1;
+        void* start = nullptr;
+        void* end = nullptr;
+        // 从这个CPU所在NUMA节点的CentralCache取（释放时槽位里可能混进别的节点的对象，不再区分）
+        size_t actualNum = CentralCache::GetInstance()->FetchRangeObj(start, end, alignSize, batchNum,
+                                                                      NumaTopology::GetInstance()->NodeOfCpu(cpu));
+
+        // 第一个返回给用户，剩下的逐个压入槽位（期间可能迁移到别的CPU，压不进去的还回CentralCache）
+        void* result = start;
+        void* cur = NextObj(start);
+        void* leftover = nullptr;
+        size_t leftoverNum = 0;
+        for (size_t i = 1; i < actualNum; ++i) {
+            void* next = NextObj(cur);
+            int ret;
+            while ((ret = RseqPush(rs, _slabs, index * sizeof(PerCpuSlot), cur)) < 0) {
+            }
+            if (ret != 0) {
+                NextObj(cur) = leftover;
+                leftover = cur;
+                ++leftoverNum;
+            }
+            cur = next;
+        }
+        if (leftover != nullptr) {
+            CentralCache::GetInstance()->ReleaseListToSpans(leftover, alignSize);
+        }
+        ClassStats& stats = Stats(index);
+        stats.allocs.Add(1);
+        stats.fetched.Add(actualNum);
+        stats.released.Add(leftoverNum);
+        return result;
+    }
+
+    // 弹空当前CPU的一个槽位，对象还给CentralCache
+    void DrainSlot(RseqArea* rs, size_t index)
+    {
+        void* list = nullptr;
+        size_t listNum = 0;
+        for (;;) {
+            void* obj = nullptr;
+            int ret;
+            while ((ret = RseqPop(rs, _slabs, index * sizeof(PerCpuSlot), &obj)) < 0) {
+            }
+            if (ret != 0) {
+                break;
+            }
+            NextObj(obj) = list;
+            list = obj;
+            ++listNum;
+        }
+        if (list != nullptr) {
+            CentralCache::GetInstance()->ReleaseListToSpans(list, SizeClass::Size(index));
+            Stats(index).released.Add(listNum);
+        }
+    }
+
+    // 当前CPU槽位已满：弹出一半，连同ptr一起还给CentralCache
+    void DeallocateSlow(RseqArea* rs, size_t index, void* ptr, size_t size)
+    {
+        uint32_t cpu = rs->_cpuId;
+        if (cpu < PERCPU_MAX_CPUS && _slabs[cpu] == nullptr) {
+            EnsureSlab(cpu);
+            Deallocate(ptr, size);
+            return;
+        }
+        if (cpu >= PERCPU_MAX_CPUS) {
+            GetTLSThreadCache()->Deallocate(ptr, size);
+            return;
+        }
+
+        void* list = ptr;
+        NextObj(list) = nullptr;
+        size_t listNum = 1;
+        size_t releaseNum = _caps[index] / 2;
+        for (size_t i = 0; i < releaseNum; ++i) {
+            void* obj = nullptr;
+            int ret;
+            while ((ret = RseqPop(rs, _slabs, index * sizeof(PerCpuSlot), &obj)) < 0) {
+            }
+            if (ret != 0) {
+                break;
+            }
+            NextObj(obj) = list;
+            list = obj;
+            ++listNum;
+        }
+        CentralCache::GetInstance()->ReleaseListToSpans(list, SizeClass::Size(index));
+        ClassStats& stats = Stats(index);
+        stats.frees.Add(1);
+        stats.released.Add(listNum);
+    }
+
+    PerCpuSlab* _slabs[PERCPU_MAX_CPUS] = {};  // 每个CPU的slab，懒创建
+    size_t _caps[NFREELIST] = {};              // 每个size class槽位的容量
+    std::mutex _initMtx;                       // 保护slab的创建
+};
+
+#endif // PERCPU_RSEQ
+
+// 小对象前端：开启per-CPU缓存时走PerCpuCache，否则走ThreadCache
+static inline void* FrontEndAllocate(size_t size)
+{
+#ifdef PERCPU_RSEQ
+    return PerCpuCache::GetInstance()->Allocate(size);
+#else
+    return GetTLSThreadCache()->Allocate(size);
+#endif
+}
+
+static inline void FrontEndDeallocate(void* ptr, size_t size)
+{
+#ifdef PERCPU_RSEQ
+    PerCpuCache::GetInstance()->Deallocate(ptr, size);
+#else
+    GetTLSThreadCache()->Deallocate(ptr, size);
+#endif
+}
+
+// 按size class索引申请/释放，ThreadCache前端跳过索引计算（per-CPU前端按对象大小走原来的接口）
+static inline void* FrontEndAllocateIndex(size_t index)
+{
+#ifdef PERCPU_RSEQ
+    return PerCpuCache::GetInstance()->Allocate(SizeClass::Size(index));
+#else
+    return GetTLSThreadCache()->AllocateIndex(index);
+#endif
+}
+
+static inline void FrontEndDeallocateIndex(void* ptr, size_t index)
+{
+#ifdef PERCPU_RSEQ
+    PerCpuCache::GetInstance()->Deallocate(ptr, SizeClass::Size(index));
+#else
+    GetTLSThreadCache()->DeallocateIndex(ptr, index);
+#endif
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// 类型化的分配接口 - 让标准容器和单个对象直接用内存池
+// PoolAllocator<T>：符合标准Allocator要求，可以用于std::list/std::map/std::unordered_map等容器
+// ConcurrentNew<T>/ConcurrentDelete<T>：分配并构造/析构并释放单个对象
+// size class索引在编译期由sizeof(T)算出，分配/释放直接按索引操作ThreadCache的FreeList，不再每次计算Index
+#include "ConcurrentMemoryPool.h"
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+// 类型T对应的size class：小对象在编译期算好索引，大对象（超过MAX_BYTES）走普通的按大小分配
+// 每个size class的对象按类大小的整数倍排在按页对齐的Span里，只要alignof(T)不超过一页就天然对齐
+template <class T>
+struct PoolSizeClass {
+    static_assert(alignof(T) <= ((size_t)1 << PAGE_SHIFT), "对齐要求超过一页的类型请用ConcurrentAlignedAlloc");
+    static constexpr bool SMALL = sizeof(T) <= MAX_BYTES;
+    static constexpr size_t INDEX = SMALL ? SizeClass::Index(sizeof(T)) : 0;
+};
+
+template <class T>
+class PoolAllocator {
+public:
+    using value_type = T;
+    // 所有PoolAllocator共用同一个内存池，可以互相释放对方分配的内存
+    using is_always_equal = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    PoolAllocator() noexcept = default;
+    template <class U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    // 一次一个对象（链表、树、哈希表的节点）按编译期索引分配，多个对象（数组、哈希桶）按总大小分配
+    T* allocate(size_t n)
+    {
+        if (n == 1 && PoolSizeClass<T>::SMALL) {
+            return (T*)ConcurrentAllocIndex(PoolSizeClass<T>::INDEX);
+        }
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return (T*)ConcurrentAlloc(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        if (n == 1 && PoolSizeClass<T>::SMALL) {
+            ConcurrentFreeIndex(p, PoolSizeClass<T>::INDEX);
+            return;
+        }
+        ConcurrentFree(p, n * sizeof(T));
+    }
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+template <class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+
+// 分配并构造一个T，构造函数抛异常时内存还回内存池
+template <class T, class... Args>
+T* ConcurrentNew(Args&&... args)
+{
+    PoolAllocator<T> alloc;
+    T* p = alloc.allocate(1);
+    try {
+        return new (p) T(std::forward<Args>(args)...);
+    } catch (...) {
+        alloc.deallocate(p, 1);
+        throw;
+    }
+}
+
+// 析构并释放ConcurrentNew<T>得到的对象，T必须和分配时的类型一致（不能用基类指针释放派生类对象）
+template <class T>
+void ConcurrentDelete(T* p)
+{
+    if (p == nullptr) {
+        return;
+    }
+    p->~T();
+    PoolAllocator<T>().deallocate(p, 1);
+}
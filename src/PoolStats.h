@@ -0,0 +1,258 @@
+#pragma once
+
+// 内存池统计汇总
+// 计数平时分散记在各处，都是普通读写，不抢同一个缓存行：
+//   1.分配/释放次数、前端缓存进出的对象数：每个线程的ThreadStats，按size class分开，只有本线程写
+//   2.CentralCache空闲对象数、Span数：每个桶一份，在桶锁内更新
+//   3.页数：PageCache每个分片一份，在分片锁内更新
+// GetPoolStats()时才把它们加起来。各项不是同一时刻的快照，多线程运行中各项之间可能有短暂的偏差，
+// 所有线程都停下来时是准确的
+// 锁竞争统计（每把锁的加锁次数、竞争次数、等待/持有时间分布）单独用GetLockProfile()汇总，需要开启ENABLE_LOCK_PROFILE
+#include "Common.h"
+#include "ThreadCache.h"
+#include "TransferCache.h"
+#include "CentralCache.h"
+#include "PageCache.h"
+#include <iomanip>
+
+// 一个size class的统计
+struct SizeClassStats {
+    size_t size = 0;                  // 对象大小
+    uint64_t allocCount = 0;          // 分配次数
+    uint64_t freeCount = 0;           // 释放次数
+    uint64_t inUseObjects = 0;        // 用户正在使用的对象数
+    uint64_t frontEndObjects = 0;     // ThreadCache（开启ENABLE_PERCPU时是per-CPU槽位）里缓存的对象数
+    uint64_t transferObjects = 0;     // 传输缓存里的对象数
+    uint64_t centralFreeObjects = 0;  // CentralCache的Span里还没分配出去的对象数
+    uint64_t spanCount = 0;           // CentralCache持有的Span数
+};
+
+struct PoolStats {
+    uint64_t allocCount = 0;          // 分配次数（小对象+大内存）
+    uint64_t freeCount = 0;           // 释放次数
+    uint64_t inUseBytes = 0;          // 用户正在使用的字节数（小对象按size class大小，大内存按页）
+    uint64_t largeInUseBytes = 0;     // 其中大内存的字节数
+    uint64_t threadCacheBytes = 0;    // 前端缓存（ThreadCache或per-CPU槽位）里的字节数
+    uint64_t transferCacheBytes = 0;  // 传输缓存里的字节数
+    uint64_t centralFreeBytes = 0;    // CentralCache的Span里空闲的字节数
+    uint64_t pageCacheFreeBytes = 0;  // PageCache里空闲、还占着物理内存的字节数
+    uint64_t returnedBytes = 0;       // 空闲并且已经还给系统（madvise）的字节数
+    uint64_t systemBytes = 0;         // 向系统申请的地址空间
+    uint64_t committedBytes = 0;      // 实际占用的内存 = systemBytes - returnedBytes
+    uint64_t peakUseBytes = 0;        // PageCache分配出去的字节数的峰值（多个分片时是上界）
+    size_t threadCount = 0;           // 用过内存池的活着的线程数
+    SizeClassStats sizeClasses[NFREELIST];
+};
+
+// 两个累计计数相减，运行中读到的值可能短暂地对不上，算出负数时按0算
+static inline uint64_t StatDiff(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : 0;
+}
+
+// 汇总所有线程、CentralCache、传输缓存、PageCache的统计
+// 要遍历所有线程并对每个size class的传输缓存槽位加一次锁，代价是微秒级，不要放在分配路径上调用
+static inline PoolStats GetPoolStats()
+{
+    PoolStats stats;
+    uint64_t allocs[NFREELIST] = {};
+    uint64_t frees[NFREELIST] = {};
+    uint64_t fetched[NFREELIST] = {};
+    uint64_t released[NFREELIST] = {};
+    uint64_t largeAllocs = 0, largeFrees = 0, largeAllocBytes = 0, largeFreeBytes = 0;
+    stats.threadCount = ThreadStats::ForEach([&](const ThreadStats& ts) {
+        for (size_t i = 0; i < NFREELIST; ++i) {
+            allocs[i] += ts.classes[i].allocs.Load();
+            frees[i] += ts.classes[i].frees.Load();
+            fetched[i] += ts.classes[i].fetched.Load();
+            released[i] += ts.classes[i].released.Load();
+        }
+        largeAllocs += ts.largeAllocs.Load();
+        largeFrees += ts.largeFrees.Load();
+        largeAllocBytes += ts.largeAllocBytes.Load();
+        largeFreeBytes += ts.largeFreeBytes.Load();
+    });
+
+    for (size_t i = 0; i < NFREELIST; ++i) {
+        SizeClassStats& sc = stats.sizeClasses[i];
+        sc.size = SizeClass::Size(i);
+        sc.allocCount = allocs[i];
+        sc.freeCount = frees[i];
+        sc.inUseObjects = StatDiff(allocs[i], frees[i]);
+        sc.frontEndObjects = StatDiff(fetched[i] + frees[i], allocs[i] + released[i]);
+        sc.transferObjects = TransferCache::GetInstance()->GetCachedObjects(i);
+        sc.centralFreeObjects = CentralCache::GetInstance()->GetFreeObjects(i);
+        sc.spanCount = CentralCache::GetInstance()->GetSpanCount(i);
+
+        stats.allocCount += sc.allocCount;
+        stats.freeCount += sc.freeCount;
+        stats.inUseBytes += sc.inUseObjects * sc.size;
+        stats.threadCacheBytes += sc.frontEndObjects * sc.size;
+        stats.transferCacheBytes += sc.transferObjects * sc.size;
+        stats.centralFreeBytes += sc.centralFreeObjects * sc.size;
+    }
+    stats.allocCount += largeAllocs;
+    stats.freeCount += largeFrees;
+    stats.largeInUseBytes = StatDiff(largeAllocBytes, largeFreeBytes);
+    stats.inUseBytes += stats.largeInUseBytes;
+
+    PageCache* pageCache = PageCache::GetInstance();
+    uint64_t systemPages = pageCache->GetSystemPages();
+    uint64_t returnedPages = pageCache->GetReturnedPages();
+    uint64_t usePages = pageCache->GetUsePages();
+    stats.systemBytes = systemPages << PAGE_SHIFT;
+    stats.returnedBytes = returnedPages << PAGE_SHIFT;
+    stats.committedBytes = StatDiff(systemPages, returnedPages) << PAGE_SHIFT;
+    stats.pageCacheFreeBytes = StatDiff(systemPages, usePages + returnedPages) << PAGE_SHIFT;
+    stats.peakUseBytes = (uint64_t)pageCache->GetPeakUsePages() << PAGE_SHIFT;
+    return stats;
+}
+
+// 打印汇总表：总览一行一项，size class只列有过分配的
+static inline void PrintPoolStats(const PoolStats& stats, std::ostream& os = std::cout)
+{
+    os << "分配次数: " << stats.allocCount << ", 释放次数: " << stats.freeCount
+       << ", 线程数: " << stats.threadCount << endl;
+    os << "使用中:       " << stats.inUseBytes << " 字节（大内存 " << stats.largeInUseBytes << "）" << endl;
+    os << "前端缓存:     " << stats.threadCacheBytes << " 字节" << endl;
+    os << "传输缓存:     " << stats.transferCacheBytes << " 字节" << endl;
+    os << "CentralCache: " << stats.centralFreeBytes << " 字节空闲" << endl;
+    os << "PageCache:    " << stats.pageCacheFreeBytes << " 字节空闲, " << stats.returnedBytes
+       << " 字节已还给系统" << endl;
+    os << "系统:         " << stats.systemBytes << " 字节申请, " << stats.committedBytes << " 字节占用, 峰值使用 "
+       << stats.peakUseBytes << " 字节" << endl;
+
+    os << std::setw(8) << "size" << std::setw(12) << "alloc" << std::setw(12) << "free" << std::setw(10) << "inuse"
+       << std::setw(10) << "frontend" << std::setw(10) << "transfer" << std::setw(10) << "central" << std::setw(8)
+       << "spans" << endl;
+    for (const SizeClassStats& sc : stats.sizeClasses) {
+        if (sc.allocCount == 0) {
+            continue;
+        }
+        os << std::setw(8) << sc.size << std::setw(12) << sc.allocCount << std::setw(12) << sc.freeCount
+           << std::setw(10) << sc.inUseObjects << std::setw(10) << sc.frontEndObjects << std::setw(10)
+           << sc.transferObjects << std::setw(10) << sc.centralFreeObjects << std::setw(8) << sc.spanCount << endl;
+    }
+}
+
+// ========== 锁竞争统计（编译时添加 -DENABLE_LOCK_PROFILE 开启，见LockProfile.h） ==========
+
+// 一把（或几把合计）锁的统计
+struct LockStats {
+    uint64_t acquisitions = 0;                   // 加锁次数
+    uint64_t contended = 0;                      // 其中需要等待的次数
+    uint64_t waitNs = 0;                         // 累计等待时间
+    uint64_t holdNs = 0;                         // 累计持有时间
+    uint64_t waitHist[LOCK_HIST_BUCKETS] = {};   // 等待时间分布，桶的划分见LockHistBucket
+    uint64_t holdHist[LOCK_HIST_BUCKETS] = {};   // 持有时间分布
+
+    void Add(const LockCounters& c) {
+        acquisitions += c.acquisitions.Load();
+        contended += c.contended.Load();
+        waitNs += c.waitNs.Load();
+        holdNs += c.holdNs.Load();
+        for (size_t i = 0; i < LOCK_HIST_BUCKETS; ++i) {
+            waitHist[i] += c.waitHist[i].Load();
+            holdHist[i] += c.holdHist[i].Load();
+        }
+    }
+};
+
+// 直方图的p分位数（0~1），返回所在桶的上界（纳秒），没有数据返回0
+static inline uint64_t LockHistPercentile(const uint64_t (&hist)[LOCK_HIST_BUCKETS], double p)
+{
+    uint64_t total = 0;
+    for (uint64_t n : hist) {
+        total += n;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LOCK_HIST_BUCKETS; ++i) {
+        seen += hist[i];
+        if (seen > rank) {
+            return LockHistBound(i);
+        }
+    }
+    return LockHistBound(LOCK_HIST_BUCKETS - 1);
+}
+
+struct LockProfile {
+    bool enabled = false;                          // 编译时没有开启ENABLE_LOCK_PROFILE时全是0
+    LockStats central[NFREELIST];                  // CentralCache每个size class的桶锁（所有节点合计）
+    LockStats transfer[NFREELIST];                 // 传输缓存每个size class的槽位锁（所有节点合计）
+    LockStats page[PAGE_CACHE_TOTAL_SHARDS];       // PageCache每个分片的锁
+};
+
+// 汇总所有锁的竞争统计，不加锁，运行中也可以随时调用（各项之间可能有短暂的偏差）
+static inline LockProfile GetLockProfile()
+{
+    LockProfile profile;
+#ifdef ENABLE_LOCK_PROFILE
+    profile.enabled = true;
+    for (size_t node = 0; node < NUMA_MAX_NODES; ++node) {
+        for (size_t i = 0; i < NFREELIST; ++i) {
+            profile.central[i].Add(CentralCache::GetInstance()->GetLockCounters(node, i));
+            profile.transfer[i].Add(TransferCache::GetInstance()->GetLockCounters(node, i));
+        }
+    }
+    for (size_t shard = 0; shard < PAGE_CACHE_TOTAL_SHARDS; ++shard) {
+        profile.page[shard].Add(PageCache::GetInstance()->GetLockCounters(shard));
+    }
+#endif
+    return profile;
+}
+
+// 打印一组锁：按累计等待时间从多到少排，只列加过锁的，最多top行
+static inline void PrintLockTable(const char* title, const char* keyName, const LockStats* stats, const size_t* keys,
+                                  size_t n, size_t top, std::ostream& os)
+{
+    size_t order[NFREELIST > PAGE_CACHE_TOTAL_SHARDS ? NFREELIST : PAGE_CACHE_TOTAL_SHARDS];
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (stats[i].acquisitions != 0) {
+            order[count++] = i;
+        }
+    }
+    std::sort(order, order + count, [stats](size_t a, size_t b) { return stats[a].waitNs > stats[b].waitNs; });
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+
+    os << title << endl;
+    os << std::setw(8) << keyName << std::setw(12) << "acquire" << std::setw(10) << "contend" << std::setw(8) << "%"
+       << std::setw(12) << "wait(us)" << std::setw(10) << "p99wait" << std::setw(10) << "avghold" << std::setw(10)
+       << "p99hold" << endl;
+    for (size_t k = 0; k < count && k < top; ++k) {
+        const LockStats& s = stats[order[k]];
+        os << std::setw(8) << keys[order[k]] << std::setw(12) << s.acquisitions << std::setw(10) << s.contended
+           << std::setw(8) << std::fixed << std::setprecision(2) << 100.0 * s.contended / s.acquisitions
+           << std::setw(12) << s.waitNs / 1000 << std::setw(10) << LockHistPercentile(s.waitHist, 0.99)
+           << std::setw(10) << s.holdNs / s.acquisitions << std::setw(10) << LockHistPercentile(s.holdHist, 0.99)
+           << endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+// 打印锁竞争表：CentralCache桶锁、传输缓存槽位锁、PageCache分片锁各一张，时间单位除了wait(us)都是ns
+// 分位数是直方图桶的上界，只精确到2倍
+static inline void PrintLockProfile(const LockProfile& profile, size_t top = 20, std::ostream& os = std::cout)
+{
+    if (!profile.enabled) {
+        os << "锁竞争统计没有开启（编译时添加 -DENABLE_LOCK_PROFILE）" << endl;
+        return;
+    }
+    size_t sizes[NFREELIST];
+    for (size_t i = 0; i < NFREELIST; ++i) {
+        sizes[i] = SizeClass::Size(i);
+    }
+    size_t shards[PAGE_CACHE_TOTAL_SHARDS];
+    for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+        shards[i] = i;
+    }
+    PrintLockTable("CentralCache桶锁:", "size", profile.central, sizes, NFREELIST, top, os);
+    PrintLockTable("传输缓存槽位锁:", "size", profile.transfer, sizes, NFREELIST, top, os);
+    PrintLockTable("PageCache分片锁:", "shard", profile.page, shards, PAGE_CACHE_TOTAL_SHARDS, top, os);
+}
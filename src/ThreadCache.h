@@ -1,15 +1,173 @@
 #pragma once
 #include "Common.h"
 #include "CentralCache.h"
+#include "TransferCache.h"
+#include "PageCache.h"
+#include "ObjectPool.h"
+
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
+
+// 一个size class在一个线程里的统计
+struct ClassStats {
+    StatCounter allocs;    // 分配出去的对象数
+    StatCounter frees;     // 还回来的对象数（对象可能是别的线程分配的）
+    StatCounter fetched;   // 从传输缓存/CentralCache取进前端缓存的对象数
+    StatCounter released;  // 从前端缓存还回传输缓存/CentralCache的对象数
+};
+
+// 每个线程自己的统计，只有这个线程写，汇总时才读，不需要原子的读-改-写
+// 前端缓存（ThreadCache或者per-CPU槽位）里的对象数 = fetched + frees - allocs - released，
+// 单个线程算出来可能是负的（比如per-CPU槽位里的对象被别的线程取走），所有线程加起来正好是总数
+// 和ThreadCache分开申请：per-CPU前端的线程只需要统计，不用为它创建整个ThreadCache（FreeList数组）
+struct ThreadStats {
+    ClassStats classes[NFREELIST];
+    StatCounter largeAllocs;      // 大内存分配次数
+    StatCounter largeFrees;
+    StatCounter largeAllocBytes;  // 大内存按页计的字节数，原地变大也算在这里
+    StatCounter largeFreeBytes;   // 原地变小也算在这里
+
+    void AddLarge(size_t bytes)
+    {
+        largeAllocs.Add(1);
+        largeAllocBytes.Add(bytes);
+    }
+    void SubLarge(size_t bytes)
+    {
+        largeFrees.Add(1);
+        largeFreeBytes.Add(bytes);
+    }
+    // 把另一份统计加进来（线程退出时并到全局的已退出线程统计里）
+    void Merge(const ThreadStats& other)
+    {
+        for (size_t i = 0; i < NFREELIST; ++i) {
+            classes[i].allocs.Add(other.classes[i].allocs.Load());
+            classes[i].frees.Add(other.classes[i].frees.Load());
+            classes[i].fetched.Add(other.classes[i].fetched.Load());
+            classes[i].released.Add(other.classes[i].released.Load());
+        }
+        largeAllocs.Add(other.largeAllocs.Load());
+        largeFrees.Add(other.largeFrees.Load());
+        largeAllocBytes.Add(other.largeAllocBytes.Load());
+        largeFreeBytes.Add(other.largeFreeBytes.Load());
+    }
+
+    // ThreadStats对象从对象池申请/归还，不依赖malloc；线程创建、退出的频率很低，用一把锁保护对象池即可
+    // 活着的线程的统计串成一个双向链表，汇总时遍历；退出线程的统计并到ExitedStats里
+    static ThreadStats* Create()
+    {
+        std::lock_guard<std::mutex> lock(PoolMutex());
+        ThreadStats* ts = Pool().New();
+        ts->_next = Head();
+        if (Head() != nullptr) {
+            Head()->_prev = ts;
+        }
+        Head() = ts;
+        return ts;
+    }
+    static void Destroy(ThreadStats* ts)
+    {
+        std::lock_guard<std::mutex> lock(PoolMutex());
+        ExitedStats().Merge(*ts);
+        if (ts->_prev != nullptr) {
+            ts->_prev->_next = ts->_next;
+        }
+        else {
+            Head() = ts->_next;
+        }
+        if (ts->_next != nullptr) {
+            ts->_next->_prev = ts->_prev;
+        }
+        Pool().Delete(ts);
+    }
+
+    // 对已退出线程的统计和每个活着的线程的统计依次调用f(const ThreadStats&)，返回活着的线程数
+    // 持有对象池的锁，期间线程不能创建/退出，但活着的线程照常分配释放（读到的是某个时刻附近的值）
+    template <class F>
+    static size_t ForEach(F f)
+    {
+        std::lock_guard<std::mutex> lock(PoolMutex());
+        f((const ThreadStats&)ExitedStats());
+        size_t count = 0;
+        for (ThreadStats* ts = Head(); ts != nullptr; ts = ts->_next) {
+            f((const ThreadStats&)*ts);
+            ++count;
+        }
+        return count;
+    }
+
+    // fork前后加解锁对象池的锁（见MallocOverride.cpp）
+    static void LockPool() { PoolMutex().lock(); }
+    static void UnlockPool() { PoolMutex().unlock(); }
+
+private:
+    static ObjectPool<ThreadStats>& Pool()
+    {
+        static ObjectPool<ThreadStats> pool;
+        return pool;
+    }
+    static std::mutex& PoolMutex()
+    {
+        static std::mutex mtx;
+        return mtx;
+    }
+    // 活着的线程的统计链表头，在PoolMutex内访问
+    static ThreadStats*& Head()
+    {
+        static ThreadStats* head = nullptr;
+        return head;
+    }
+    // 已经退出的线程的统计之和，在PoolMutex内更新
+    static ThreadStats& ExitedStats()
+    {
+        static ThreadStats stats;
+        return stats;
+    }
+
+    ThreadStats* _prev = nullptr;  // 活着的线程的统计链表
+    ThreadStats* _next = nullptr;
+};
 
 class ThreadCache
 {
 public:
+    // ThreadCache对象从对象池申请/归还，不依赖malloc
+    // 线程创建、退出的频率很低，用一把锁保护对象池即可
+    // stats是本线程的统计（GetThreadStats()），比ThreadCache活得久，线程退出时才释放
+    static ThreadCache* Create(ThreadStats* stats)
+    {
+        std::lock_guard<std::mutex> lock(PoolMutex());
+        ThreadCache* tc = Pool().New();
+        tc->_node = NumaTopology::GetInstance()->CurrentNode();
+        tc->_stats = stats;
+        return tc;
+    }
+    static void Destroy(ThreadCache* tc)
+    {
+        std::lock_guard<std::mutex> lock(PoolMutex());
+        Pool().Delete(tc);
+    }
+    // fork前后加解锁对象池的锁（见MallocOverride.cpp）
+    static void LockPool() { PoolMutex().lock(); }
+    static void UnlockPool() { PoolMutex().unlock(); }
+
     // 申请和释放内存对象
     void* Allocate(size_t size)
     {
         //1.计算索引
-        size_t index = SizeClass::Index(size);
+        return AllocateIndex(SizeClass::Index(size));
+    };
+    void Deallocate(void* ptr, size_t size)
+    {
+        //1.计算索引，和Allocate一样
+        DeallocateIndex(ptr, SizeClass::Index(size));
+    };
+    
+    // 已经知道size class索引时直接用索引申请/释放（PoolAllocator在编译期算好索引）
+    void* AllocateIndex(size_t index)
+    {
+        _stats->classes[index].allocs.Add(1);
         //2.检查对应的Freelist是否为空
         if(!_freeLists[index].Empty())
         {
@@ -17,59 +175,227 @@ public:
             return _freeLists[index].Pop();
         }
         //没内存了，向CentralCache批量申请
-        return FetchFromCentralCache(index, SizeClass::RoundUp(size));
+        return FetchFromCentralCache(index);
     };
-    void Deallocate(void* ptr, size_t size)
+    void DeallocateIndex(void* ptr, size_t index)
     {
-        //1.计算索引，和Allocate一样
-        size_t index = SizeClass::Index(size);
+        _stats->classes[index].frees.Add(1);
+#ifdef ENABLE_NUMA
+        // 别的节点的对象不放进FreeList（否则会被当成本节点内存分配出去），攒一批还回它所在的节点
+        if (PageCache::NodeOf(PageCache::GetInstance()->MapObjectToSpan(ptr)) != _node) {
+            DeallocateRemote(index, ptr);
+            return;
+        }
+#endif
         //2.将对象push到对应的Freelist中
         _freeLists[index].Push(ptr);
         
         //3.检查是否需要批量归还给CentralCache
         if (ListTooLong(index)) {
-            // TODO: 实现批量归还给CentralCache的逻辑
-            ReleaseToCentralCache(index,size);
+            ListOverflow(index);
         }
     };
 
+    // 批量申请n个同样大小的对象写入out：先整段取FreeList里缓存的，不够的按批直接从传输缓存/CentralCache取，
+    // 不经过FreeList中转
+    void AllocateBatch(size_t size, size_t n, void** out)
+    {
+        size_t index = SizeClass::Index(size);
+        _stats->classes[index].allocs.Add(n);
+        FreeList& list = _freeLists[index];
+        size_t cached = min(n, list.Size());
+        if (cached > 0) {
+            void* start = nullptr;
+            void* end = nullptr;
+            list.PopRange(start, end, cached);
+            for (void* cur = start; cur != nullptr; cur = NextObj(cur)) {
+                *out++ = cur;
+            }
+            n -= cached;
+        }
+        
+        size_t alignSize = SizeClass::Size(index);
+        size_t batchNum = SizeClass::BatchSize(index);
+        while (n > 0) {
+            void* start = nullptr;
+            void* end = nullptr;
+            size_t actualNum = TransferCache::GetInstance()->RemoveRange(start, end, alignSize, min(n, batchNum), _node);
+            _stats->classes[index].fetched.Add(actualNum);
+            void* cur = start;
+            for (size_t i = 0; i < actualNum; ++i) {
+                *out++ = cur;
+                cur = NextObj(cur);
+            }
+            n -= actualNum;
+        }
+    }
+    
+    // 批量释放n个同样大小的对象：先串成一条链表整段挂到FreeList，超长了再按批还回去
+    void DeallocateBatch(void** ptrs, size_t n, size_t size)
+    {
+#ifdef ENABLE_NUMA
+        // 可能混着别的节点的对象，逐个按节点区分
+        for (size_t i = 0; i < n; ++i) {
+            Deallocate(ptrs[i], size);
+        }
+#else
+        if (n == 0) {
+            return;
+        }
+        size_t index = SizeClass::Index(size);
+        _stats->classes[index].frees.Add(n);
+        for (size_t i = 0; i + 1 < n; ++i) {
+            NextObj(ptrs[i]) = ptrs[i + 1];
+        }
+        _freeLists[index].PushRange(ptrs[0], ptrs[n - 1], n);
+        
+        size_t batchNum = SizeClass::BatchSize(index);
+        while (ListTooLong(index)) {
+            ReleaseToCentralCache(index, min(_freeLists[index].Size(), batchNum));
+        }
+#endif
+    }
+
+    // 线程退出时调用：把所有FreeList里缓存的对象还给CentralCache
+    // 否则这些对象以及它们占着的Span永远回不到PageCache
+    void ReleaseAll()
+    {
+        for (size_t i = 0; i < NFREELIST; ++i) {
+            if (_freeLists[i].Empty()) {
+                continue;
+            }
+            void* start = nullptr;
+            void* end = nullptr;
+            _stats->classes[i].released.Add(_freeLists[i].Size());
+            _freeLists[i].PopRange(start, end, _freeLists[i].Size());
+            CentralCache::GetInstance()->ReleaseListToSpans(start, SizeClass::Size(i));
+        }
+#ifdef ENABLE_NUMA
+        // 还没攒够一批的远端对象
+        for (size_t i = 0; i < NFREELIST; ++i) {
+            if (_remoteLists[i].Empty()) {
+                continue;
+            }
+            void* start = nullptr;
+            void* end = nullptr;
+            _stats->classes[i].released.Add(_remoteLists[i].Size());
+            _remoteLists[i].PopRange(start, end, _remoteLists[i].Size());
+            CentralCache::GetInstance()->ReleaseListToSpans(start, SizeClass::Size(i));
+        }
+#endif
+    }
+
+    // 某个FreeList当前的长度上限（慢启动增长到的值）和它能增长到的最大值，观察自适应策略用
+    size_t GetMaxSize(size_t index) { return _freeLists[index].MaxSize(); }
+    static size_t GetCacheLimit(size_t index) { return CacheLimit(index); }
+
+    // 所属的NUMA节点，从这个节点的CentralCache取对象
+    size_t GetNode() const { return _node; }
+
+    // 线程换了节点：缓存的对象都是原节点的，先全部还回去
+    void SetNode(size_t node)
+    {
+        if (node != _node) {
+            ReleaseAll();
+            _node = node;
+        }
+    }
+
 private:
     // 性能调优：提高缓存阈值，减少触发释放频率
     // NumMoveSize上限512，阈值设为1536（3倍）
     // 这样拿3次（512×3=1536）才触发释放，减少锁竞争
+    // 自适应策略下作为每个FreeList长度上限（_maxSize）能增长到的最大值
     static const size_t SMALL_OBJ_MAX_COUNT = 1536;   // 小对象最大缓存数（原512）
     static const size_t MEDIUM_OBJ_MAX_COUNT = 768;   // 中等对象最大缓存数（原256）
     static const size_t LARGE_OBJ_MAX_COUNT = 192;    // 大对象最大缓存数（原64）
+    static const size_t MAX_OVERAGES = 3;             // 连续超长几次后收缩_maxSize
 
-    // 检查FreeList是否过长，需要批量归还
-    bool ListTooLong(size_t index)
+    // 每个FreeList最多缓存多少个对象
+    static size_t MaxCount(size_t index)
     {
-        size_t maxCount = 0;
-        
         if (index <= 15) {        // 8-128字节，小对象
-            maxCount = SMALL_OBJ_MAX_COUNT;
+            return SMALL_OBJ_MAX_COUNT;
         } 
         else if (index <= 71) {   // 129-1024字节，中等对象  
-            maxCount = MEDIUM_OBJ_MAX_COUNT;
+            return MEDIUM_OBJ_MAX_COUNT;
         }
         else {                    // 更大的对象
-            maxCount = LARGE_OBJ_MAX_COUNT;
+            return LARGE_OBJ_MAX_COUNT;
         }
-        
-        return _freeLists[index].Size() > maxCount;
     }
 
-    // 向CentralCache批量申请内存对象
-    void* FetchFromCentralCache(size_t index, size_t size)
+    // 自适应策略下FreeList长度上限能增长到的最大值，至少一批
+    static size_t CacheLimit(size_t index)
+    {
+        return MaxCount(index) > SizeClass::BatchSize(index) ? MaxCount(index) : SizeClass::BatchSize(index);
+    }
+
+    // 检查FreeList是否过长，需要批量归还
+    // 编译时添加 -DFIXED_BATCH_POLICY 使用原来的固定阈值策略（用于性能对比）
+    bool ListTooLong(size_t index)
+    {
+#ifdef FIXED_BATCH_POLICY
+        return _freeLists[index].Size() > MaxCount(index);
+#else
+        return _freeLists[index].Size() > _freeLists[index].MaxSize();
+#endif
+    }
+
+    // FreeList超长：归还一批对象，并调整_maxSize
+    void ListOverflow(size_t index)
     {
+#ifdef FIXED_BATCH_POLICY
+        ReleaseToCentralCache(index, _freeLists[index].Size() >> 1);//一半
+#else
+        FreeList& list = _freeLists[index];
+        size_t batchNum = SizeClass::BatchSize(index);
         
+        // 归还个数跟着批量大小走：一次还一批，而不是直接砍掉一半
+        ReleaseToCentralCache(index, min(list.Size(), batchNum));
         
+        if (list.MaxSize() < batchNum) {
+            // 还在慢启动阶段，继续缓慢增长
+            list.MaxSize() += 1;
+        }
+        else if (list.MaxSize() > batchNum) {
+            // 上限已经超过一批，但还是频繁超长，说明缓存太多用不上，连续几次后收缩一批（最少保留一批）
+            if (++list.Overages() > MAX_OVERAGES) {
+                list.MaxSize() = list.MaxSize() - batchNum > batchNum ? list.MaxSize() - batchNum : batchNum;
+                list.Overages() = 0;
+            }
+        }
+#endif
+    }
+
+    // 向CentralCache批量申请内存对象
+    void* FetchFromCentralCache(size_t index)
+    {
         void* start = nullptr;
         void* end = nullptr;
+        size_t size = SizeClass::Size(index);
         
-        // 从CentralCache批量获取对象，获取实际数量
-        size_t batchNum =  SizeClass::NumMoveSize(size);
-        size_t actualNum = CentralCache::GetInstance()->FetchRangeObj(start, end, size, batchNum);
+#ifdef FIXED_BATCH_POLICY
+        size_t batchNum = SizeClass::BatchSize(index);
+#else
+        // 慢启动：第一次只拿1个，之后每次未命中都增长，
+        // 小于一批时每次+1，达到一批后每次加一整批，直到MaxCount
+        FreeList& list = _freeLists[index];
+        size_t limit = SizeClass::BatchSize(index);
+        size_t batchNum = min(list.MaxSize(), limit);
+        if (list.MaxSize() < limit) {
+            list.MaxSize() += 1;
+        }
+        else {
+            // 上限不一定是一批的整数倍（比如200字节一批512个、上限768个），最后一次增长直接到上限，
+            // 不能再向下取整到整批，否则永远停在一批
+            list.MaxSize() = min(list.MaxSize() + limit, CacheLimit(index));
+        }
+#endif
+        
+        // 批量获取对象（整批先查传输缓存，再查CentralCache），获取实际数量
+        size_t actualNum = TransferCache::GetInstance()->RemoveRange(start, end, size, batchNum, _node);
+        _stats->classes[index].fetched.Add(actualNum);
         
         // 把前actualNum-1个Push到FreeList缓存
         void* cur = start;
@@ -82,29 +408,110 @@ private:
         // 返回最后一个对象给用户
         return cur;
     }
-    void ReleaseToCentralCache(size_t index, size_t size)
+    void ReleaseToCentralCache(size_t index, size_t releaseNum)
     {
-        //步骤1.计算归还个数
-        size_t releaseNum = _freeLists[index].Size() >> 1;//一半
-        //步骤2.从FreeList弹出releaseNum个对象
+        //步骤1.从FreeList弹出releaseNum个对象
         void* start = nullptr;
         void* end = nullptr;
+        _stats->classes[index].released.Add(releaseNum);
         _freeLists[index].PopRange(start, end, releaseNum);//调用PopRange函数，从FreeList批量弹出releaseNum个对象
-        //步骤3.计算对象大小
-        //这里选择直接传入size，省去从索引计算size的步骤，我们没有实现从索引计算size的函数，这里直接传入size，也提高了效率
-        //步骤4.调用CentralCache::ReleaseListToSpans()将对象链表返回给CentralCache
-        CentralCache::GetInstance()->ReleaseListToSpans(start, size);
+        //步骤2.对象大小直接按索引查表，不用再从调用方一路传下来
+        //步骤3.交给传输缓存：正好一整批就缓存起来给别的线程用，否则还给CentralCache
+        TransferCache::GetInstance()->InsertRange(start, end, releaseNum, SizeClass::Size(index), _node);
+    }
+#ifdef ENABLE_NUMA
+    // 远端对象攒够一批就还给CentralCache（按对象所在节点加锁）
+    void DeallocateRemote(size_t index, void* ptr)
+    {
+        FreeList& list = _remoteLists[index];
+        list.Push(ptr);
+        if (list.Size() >= SizeClass::BatchSize(index)) {
+            void* start = nullptr;
+            void* end = nullptr;
+            _stats->classes[index].released.Add(list.Size());
+            list.PopRange(start, end, list.Size());
+            CentralCache::GetInstance()->ReleaseListToSpans(start, SizeClass::Size(index));
+        }
+    }
+#endif
+    static ObjectPool<ThreadCache>& Pool()
+    {
+        static ObjectPool<ThreadCache> pool;
+        return pool;
+    }
+    static std::mutex& PoolMutex()
+    {
+        static std::mutex mtx;
+        return mtx;
     }
+
     FreeList _freeLists[NFREELIST];  // 自由链表数组
+    size_t _node = 0;                // 所属的NUMA节点
+    ThreadStats* _stats = nullptr;   // 本线程的统计
+#ifdef ENABLE_NUMA
+    FreeList _remoteLists[NFREELIST];  // 别的节点的对象，攒一批再还
+#endif
 };
 
-// 通过TLS 每个线程无锁的获取自己的专属的ThreadCache对象
+// 通过TLS 每个线程无锁的获取自己的专属的ThreadCache对象和统计
+// 统计单独申请：per-CPU前端只用统计，ThreadCache要到真正走线程缓存时才创建
 static thread_local ThreadCache* pTLSThreadCache = nullptr;
+static thread_local ThreadStats* pTLSThreadStats = nullptr;
+
+// 线程退出时：缓存的对象还给CentralCache，ThreadCache对象还给对象池，统计并到已退出线程的统计里
+// 两者共用一个退出回调，保证ThreadCache先还完对象（会更新统计）再释放统计
+static inline void ThreadCacheExit(void*)
+{
+    if (pTLSThreadCache != nullptr) {
+        pTLSThreadCache->ReleaseAll();
+        ThreadCache::Destroy(pTLSThreadCache);
+        pTLSThreadCache = nullptr;
+    }
+    if (pTLSThreadStats != nullptr) {
+        ThreadStats::Destroy(pTLSThreadStats);
+        pTLSThreadStats = nullptr;
+    }
+}
+
+#ifdef _WIN32
+// Windows下借助thread_local对象的析构函数感知线程退出
+struct ThreadCacheReleaser {
+    ~ThreadCacheReleaser() {
+        ThreadCacheExit(nullptr);
+    }
+};
+static thread_local ThreadCacheReleaser tThreadCacheReleaser;
+#else
+// Linux下用pthread key的析构函数：线程退出时自动以key对应的值调用ThreadCacheExit
+// 不用thread_local对象的析构函数，是因为注册它（__cxa_thread_atexit）本身可能会调用malloc
+static inline pthread_key_t GetThreadCacheKey()
+{
+    static pthread_key_t key = []() {
+        pthread_key_t k;
+        pthread_key_create(&k, ThreadCacheExit);
+        return k;
+    }();
+    return key;
+}
+#endif
+
+// 获取当前线程的统计，第一次调用时创建并登记线程退出回调
+static inline ThreadStats* GetThreadStats() {
+    if (pTLSThreadStats == nullptr) {
+        pTLSThreadStats = ThreadStats::Create();
+#ifdef _WIN32
+        (void)&tThreadCacheReleaser;  // 访问一次，保证当前线程构造了释放器
+#else
+        pthread_setspecific(GetThreadCacheKey(), pTLSThreadStats);
+#endif
+    }
+    return pTLSThreadStats;
+}
 
 // 获取当前线程的ThreadCache对象
-static ThreadCache* GetTLSThreadCache() {
+static inline ThreadCache* GetTLSThreadCache() {
     if (pTLSThreadCache == nullptr) {
-        pTLSThreadCache = new ThreadCache;
+        pTLSThreadCache = ThreadCache::Create(GetThreadStats());
     }
     return pTLSThreadCache;
 }
@@ -0,0 +1,152 @@
+#pragma once
+
+// 传输缓存 - 夹在ThreadCache和CentralCache之间
+// 每个size class缓存若干"整批"对象（{start, end}，一批正好NumMoveSize个）。
+// 一个线程归还的一整批可以原样交给另一个线程取走，O(1)，不用查页表、不用动Span；
+// 只有传输缓存空了（取不到）或者满了（放不下）才落到CentralCache。
+// 编译时添加 -DDISABLE_TRANSFER_CACHE 关闭，直接走CentralCache（对比测试用）
+// 开启ENABLE_NUMA时每个节点各有一套槽位，一批对象只在同一个节点的线程之间传递
+#include "Common.h"
+#include "CentralCache.h"
+#include "PageCache.h"
+
+static const size_t TRANSFER_CACHE_MAX_BATCHES = 64;      // 每个size class最多缓存的批数
+static const size_t TRANSFER_CACHE_BYTES = 256 * 1024;   // 每个size class最多缓存的字节数（大对象少缓存）
+
+class TransferCache {
+public:
+    static TransferCache* GetInstance() {
+        static TransferCache instance;
+        return &instance;
+    }
+
+    // 取一批对象，接口和CentralCache::FetchRangeObj一致
+    // 只有正好要一整批时才查传输缓存，其余情况直接转给CentralCache
+    size_t RemoveRange(void*& start, void*& end, size_t size, size_t num, size_t node = 0) {
+#ifndef DISABLE_TRANSFER_CACHE
+        size_t index = SizeClass::Index(size);
+        if (num == SizeClass::BatchSize(index)) {
+            Slot& slot = _slots[node][index];
+            Lock(slot);
+            if (slot._used > 0) {
+                --slot._used;
+                start = slot._batches[slot._used]._start;
+                end = slot._batches[slot._used]._end;
+                Unlock(slot);
+                return num;
+            }
+            Unlock(slot);
+        }
+#endif
+        return CentralCache::GetInstance()->FetchRangeObj(start, end, size, (int)num, node);
+    }
+
+    // 归还n个对象（start..end，end的next必须是nullptr），对象都属于node节点
+    // 正好一整批且还有空位时放进传输缓存，否则还回Span
+    void InsertRange(void* start, void* end, size_t n, size_t size, size_t node = 0) {
+#ifndef DISABLE_TRANSFER_CACHE
+        size_t index = SizeClass::Index(size);
+        if (n == SizeClass::BatchSize(index)) {
+            Slot& slot = _slots[node][index];
+            Lock(slot);
+            if (slot._used < Capacity(index)) {
+                slot._batches[slot._used]._start = start;
+                slot._batches[slot._used]._end = end;
+                ++slot._used;
+                Unlock(slot);
+                return;
+            }
+            Unlock(slot);
+        }
+#else
+        (void)end;
+        (void)n;
+        (void)node;
+#endif
+        CentralCache::GetInstance()->ReleaseListToSpans(start, size);
+    }
+
+    // 把传输缓存里所有批次还回Span（之后Span才有机会回到PageCache）
+    void Flush() {
+        for (size_t i = 0; i < NUMA_MAX_NODES * NFREELIST; ++i) {
+            Slot& slot = _slots[i / NFREELIST][i % NFREELIST];
+            while (true) {
+                Lock(slot);
+                if (slot._used == 0) {
+                    Unlock(slot);
+                    break;
+                }
+                --slot._used;
+                void* start = slot._batches[slot._used]._start;
+                Unlock(slot);
+
+                // 同一个槽位里的对象大小相同，从所属Span取对象大小
+                size_t size = PageCache::GetInstance()->MapObjectToSpan(start)->_objSize;
+                CentralCache::GetInstance()->ReleaseListToSpans(start, size);
+            }
+        }
+    }
+
+    // 某个size class（所有节点合计）缓存着的对象数，汇总统计用
+    size_t GetCachedObjects(size_t index) {
+        size_t batches = 0;
+        for (size_t node = 0; node < NUMA_MAX_NODES; ++node) {
+            Slot& slot = _slots[node][index];
+            Lock(slot);
+            batches += slot._used;
+            Unlock(slot);
+        }
+        return batches * SizeClass::BatchSize(index);
+    }
+
+    // fork前拿住所有槽位锁，fork后在父子进程里各自释放（见MallocOverride.cpp）
+    void LockAll() {
+        for (size_t i = 0; i < NUMA_MAX_NODES * NFREELIST; ++i) {
+            Lock(_slots[i / NFREELIST][i % NFREELIST]);
+        }
+    }
+    void UnlockAll() {
+        for (size_t i = 0; i < NUMA_MAX_NODES * NFREELIST; ++i) {
+            Unlock(_slots[i / NFREELIST][i % NFREELIST]);
+        }
+    }
+
+#ifdef ENABLE_LOCK_PROFILE
+    // 某个节点某个size class的槽位锁的竞争统计
+    const LockCounters& GetLockCounters(size_t node, size_t index) const { return _slots[node][index]._mtx.mtx.Counters(); }
+#endif
+
+private:
+    TransferCache() {}
+    TransferCache(const TransferCache&) = delete;
+    TransferCache& operator=(const TransferCache&) = delete;
+
+    struct Batch {
+        void* _start;
+        void* _end;
+    };
+
+    // 一个size class的批次栈，后进先出（刚还回来的批次更可能还在缓存里）
+    struct alignas(64) Slot {
+        PaddedMutex _mtx;
+        size_t _used = 0;
+        Batch _batches[TRANSFER_CACHE_MAX_BATCHES];
+    };
+
+    // 每个size class能缓存的批数：按字节数限制，至少1批
+    static size_t Capacity(size_t index) {
+        size_t num = TRANSFER_CACHE_BYTES / (SizeClass::BatchSize(index) * SizeClass::Size(index));
+        if (num < 1) num = 1;
+        if (num > TRANSFER_CACHE_MAX_BATCHES) num = TRANSFER_CACHE_MAX_BATCHES;
+        return num;
+    }
+
+    void Lock(Slot& slot) {
+        slot._mtx.mtx.lock();
+    }
+    void Unlock(Slot& slot) {
+        slot._mtx.mtx.unlock();
+    }
+
+    Slot _slots[NUMA_MAX_NODES][NFREELIST];
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+// 测试共用的辅助函数
+#include "../src/ConcurrentMemoryPool.h"
+
+// 清空当前线程的ThreadCache和传输缓存，空闲的Span还回PageCache（per-CPU缓存的槽位没法清空，什么都不做）
+static inline void DrainCaches()
+{
+#ifndef PERCPU_RSEQ
+    GetTLSThreadCache()->ReleaseAll();
+    TransferCache::GetInstance()->Flush();
+#endif
+}
+
+// 清空缓存后，Span应该全部还回PageCache，使用中的页数回到baseline（开启ENABLE_PERCPU时不检查）
+static inline void CheckBaseline(size_t baseline)
+{
+    DrainCaches();
+#ifndef PERCPU_RSEQ
+    assert(PageCache::GetInstance()->GetUsePages() == baseline);
+#else
+    (void)baseline;
+#endif
+}
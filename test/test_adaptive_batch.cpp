@@ -0,0 +1,159 @@
+// 自适应批量（慢启动）测试 - 对比固定批量策略的内存占用和吞吐
+// 默认编译为自适应策略，添加 -DFIXED_BATCH_POLICY 编译为原来的固定策略，两次结果对比：
+//   g++ -std=c++17 -O2 -pthread test/test_adaptive_batch.cpp src/CentralCache.cpp src/PageCache.cpp -o adaptive
+//   g++ -std=c++17 -O2 -pthread -DFIXED_BATCH_POLICY test/test_adaptive_batch.cpp src/CentralCache.cpp src/PageCache.cpp -o fixed
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+#ifdef FIXED_BATCH_POLICY
+static const char* POLICY_NAME = "固定批量";
+#else
+static const char* POLICY_NAME = "自适应批量";
+#endif
+
+// 场景1：很多线程，每个线程每种大小只用几个对象
+// 固定策略下每个线程每种大小都会拉一整批（最多512个），内存随线程数成倍放大
+void SparseTask(vector<void*>* out) {
+    for (size_t size = 8; size <= 1024; size *= 2) {
+        for (int i = 0; i < 4; ++i) {
+            out->push_back(ConcurrentAlloc(size));
+        }
+    }
+}
+
+void TestSparseFootprint(size_t threadCount) {
+    cout << "=== 场景1: " << threadCount << "线程稀疏使用（内存占用） ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+
+    // 线程结束前先不释放，保持ThreadCache存活，观察占用的页数
+    vector<vector<void*>> ptrs(threadCount);
+    vector<thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&ptrs, i]() {
+            SparseTask(&ptrs[i]);
+            // 释放一半，让对象留在ThreadCache里
+            for (size_t j = 0; j < ptrs[i].size(); j += 2) {
+                ConcurrentFree(ptrs[i][j]);
+            }
+            this_thread::sleep_for(chrono::milliseconds(200));
+        });
+    }
+    this_thread::sleep_for(chrono::milliseconds(100));
+    size_t used = PageCache::GetInstance()->GetUsePages() - baseline;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    cout << "[" << POLICY_NAME << "] 占用页数: " << used
+         << " (" << (double)(used << PAGE_SHIFT) / 1024 / 1024 << " MB)" << endl;
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        for (size_t j = 1; j < ptrs[i].size(); j += 2) {
+            ConcurrentFree(ptrs[i][j]);
+        }
+    }
+    cout << endl;
+}
+
+// 场景2：热点大小，单线程反复批量申请释放（吞吐）
+void TestHotThroughput(size_t size, size_t count, size_t rounds) {
+    vector<void*> ptrs(count);
+
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            ptrs[i] = ConcurrentAlloc(size);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            ConcurrentFree(ptrs[i], size);
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    long long ms = chrono::duration_cast<chrono::milliseconds>(end - start).count();
+    cout << "[" << POLICY_NAME << "] " << size << "字节 x " << count << "个 x " << rounds << "轮: "
+         << ms << " ms";
+    if (ms > 0) {
+        cout << "，吞吐 " << (double)count * rounds * 2 / ms / 1000 << " M ops/s";
+    }
+    cout << endl;
+}
+
+// 场景3：多线程热点吞吐
+void TestMultiThreadThroughput(size_t threadCount, size_t size) {
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([size]() {
+            vector<void*> ptrs(2000);
+            for (int r = 0; r < 200; ++r) {
+                for (auto& p : ptrs) p = ConcurrentAlloc(size);
+                for (auto& p : ptrs) ConcurrentFree(p, size);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << "[" << POLICY_NAME << "] " << threadCount << "线程 " << size << "字节: "
+         << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+}
+
+// 场景4：一个线程持续分配同一个中等大小，FreeList的长度上限应该一直涨到上限
+// 200字节一批512个、上限768个，上限不是一批的整数倍，以前会卡在一批
+void TestGrowToCap(size_t size) {
+    cout << "=== 场景4: " << size << "字节的长度上限增长到最大值 ===" << endl;
+#ifdef FIXED_BATCH_POLICY
+    cout << "[" << POLICY_NAME << "] 没有长度上限，跳过" << endl << endl;
+#else
+    thread t([size]() {
+        // 直接用ThreadCache，开启ENABLE_PERCPU时也测同一套策略
+        ThreadCache* tc = GetTLSThreadCache();
+        size_t index = SizeClass::Index(size);
+        vector<void*> ptrs(200000);
+        for (void*& p : ptrs) {
+            p = tc->Allocate(size);
+        }
+        size_t maxSize = tc->GetMaxSize(index);
+        cout << "[" << POLICY_NAME << "] 一批 " << SizeClass::BatchSize(index) << " 个, 上限 "
+             << ThreadCache::GetCacheLimit(index) << " 个, 实际增长到 " << maxSize << " 个" << endl;
+        assert(maxSize == ThreadCache::GetCacheLimit(index));
+        assert(ThreadCache::GetCacheLimit(index) % SizeClass::BatchSize(index) != 0);
+        for (void* p : ptrs) {
+            tc->Deallocate(p, size);
+        }
+        // 频繁超长时收缩，但不会少于一批
+        assert(tc->GetMaxSize(index) >= SizeClass::BatchSize(index));
+    });
+    t.join();
+    cout << "OK" << endl << endl;
+#endif
+}
+
+int main() {
+    cout << "========== 批量策略对比：" << POLICY_NAME << " ==========" << endl << endl;
+
+    TestSparseFootprint(64);
+
+    cout << "=== 场景2: 单线程热点吞吐 ===" << endl;
+    TestHotThroughput(16, 1, 5000000);
+    TestHotThroughput(16, 1000, 5000);
+    TestHotThroughput(1024, 1000, 2000);
+    cout << endl;
+
+    cout << "=== 场景3: 多线程热点吞吐 ===" << endl;
+    TestMultiThreadThroughput(4, 16);
+    TestMultiThreadThroughput(4, 256);
+    cout << endl;
+
+    TestGrowToCap(200);
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+// 批量分配/释放测试 - ConcurrentAllocBatch / ConcurrentFreeBatch
+// 正确性：对象互不重叠、可以和单个接口混用、多线程交叉释放、Span全部还回PageCache
+// 性能：和逐个调用ConcurrentAlloc/ConcurrentFree的循环对比（ns/对象）
+//   g++ -std=c++17 -O2 -pthread test/test_batch.cpp src/CentralCache.cpp src/PageCache.cpp -o batch
+#include "../src/ConcurrentMemoryPool.h"
+#include "TestUtil.h"
+#include <chrono>
+#include <vector>
+#include <set>
+#include <string.h>
+
+using namespace std;
+
+void TestBatch() {
+    cout << "=== 测试1: 批量分配释放 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    size_t sizes[] = {8, 24, 100, 1024, 5000, 64 * 1024, 256 * 1024, 300 * 1024};
+    size_t counts[] = {1, 7, 100, 513, 3000};
+    for (size_t size : sizes) {
+        for (size_t n : counts) {
+            if (size > 64 * 1024 && n > 100) {
+                continue;  // 大对象数量太多占内存太大
+            }
+            vector<void*> ptrs(n);
+            ConcurrentAllocBatch(size, n, ptrs.data());
+
+            // 每个对象都能写满，互不重叠
+            set<void*> unique(ptrs.begin(), ptrs.end());
+            assert(unique.size() == n);
+            for (size_t i = 0; i < n; ++i) {
+                memset(ptrs[i], (int)(i & 0xff), size);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                assert(((unsigned char*)ptrs[i])[0] == (i & 0xff));
+                assert(((unsigned char*)ptrs[i])[size - 1] == (i & 0xff));
+            }
+
+            // 一半批量释放，一半逐个释放
+            ConcurrentFreeBatch(ptrs.data(), n / 2, size);
+            for (size_t i = n / 2; i < n; ++i) {
+                ConcurrentFree(ptrs[i], size);
+            }
+        }
+        cout << "  " << size << "字节 OK" << endl;
+    }
+
+    // 逐个分配的对象也能批量释放
+    vector<void*> ptrs(1000);
+    for (auto& p : ptrs) {
+        p = ConcurrentAlloc(48);
+    }
+    ConcurrentFreeBatch(ptrs.data(), ptrs.size(), 48);
+
+    CheckBaseline(baseline);
+    cout << endl;
+}
+
+// 生产者批量分配，消费者批量释放（对象在线程之间流动）
+void TestCrossThread() {
+    cout << "=== 测试2: 跨线程批量释放 ===" << endl;
+
+    const size_t rounds = 200;
+    const size_t n = 300;
+    vector<vector<void*>> batches(rounds, vector<void*>(n));
+    thread producer([&batches]() {
+        for (auto& batch : batches) {
+            ConcurrentAllocBatch(64, n, batch.data());
+            for (void* p : batch) {
+                memset(p, 0x7f, 64);
+            }
+        }
+    });
+    producer.join();
+    thread consumer([&batches]() {
+        for (auto& batch : batches) {
+            ConcurrentFreeBatch(batch.data(), n, 64);
+        }
+    });
+    consumer.join();
+    cout << rounds << "批 x " << n << "个对象 OK" << endl << endl;
+}
+
+// 每轮分配n个再全部释放，返回平均每个对象（分配+释放）的纳秒数
+static double Benchmark(size_t size, size_t n, bool batch) {
+    const size_t rounds = 2000;
+    vector<void*> ptrs(n);
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        if (batch) {
+            ConcurrentAllocBatch(size, n, ptrs.data());
+            ConcurrentFreeBatch(ptrs.data(), n, size);
+        }
+        else {
+            for (size_t i = 0; i < n; ++i) {
+                ptrs[i] = ConcurrentAlloc(size);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                ConcurrentFree(ptrs[i], size);
+            }
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (rounds * n);
+}
+
+void TestPerformance() {
+    cout << "=== 测试3: 批量接口 vs 逐个循环（ns/对象） ===" << endl;
+
+    size_t cases[][2] = {{32, 100}, {32, 500}, {256, 100}, {256, 500}, {2048, 200}};
+    for (auto& c : cases) {
+        Benchmark(c[0], c[1], false);  // 预热，让FreeList的慢启动上限涨上去
+        double loop = Benchmark(c[0], c[1], false);
+        double batch = Benchmark(c[0], c[1], true);
+        cout << "  " << c[0] << "字节 x " << c[1] << ": 逐个 " << loop << " ns, 批量 " << batch << " ns" << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestBatch();
+    TestCrossThread();
+    TestPerformance();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -29,11 +29,8 @@ long long BenchmarkMalloc(size_t size, size_t rounds, const char* testName) {
 long long BenchmarkMemoryPool(size_t size, size_t rounds, const char* testName) {
     cout << "\n【" << testName << "】内存池测试" << endl;
     
-    // 重置统计数据
-    g_allocCount.store(0);
-    g_freeCount.store(0);
-    g_currentMemory.store(0);
-    g_peakMemory.store(0);
+    // 统计是累计值，记下开始时的值
+    PoolStats before = GetPoolStats();
     
     auto start = std::chrono::high_resolution_clock::now();
     
@@ -46,9 +43,10 @@ long long BenchmarkMemoryPool(size_t size, size_t rounds, const char* testName)
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     
     cout << "内存池耗时: " << duration << " ms" << endl;
-    cout << "分配次数: " << g_allocCount.load() << endl;
-    cout << "释放次数: " << g_freeCount.load() << endl;
-    cout << "峰值内存: " << g_peakMemory.load() / 1024 << " KB" << endl;
+    PoolStats after = GetPoolStats();
+    cout << "分配次数: " << after.allocCount - before.allocCount << endl;
+    cout << "释放次数: " << after.freeCount - before.freeCount << endl;
+    cout << "峰值内存: " << after.peakUseBytes / 1024 << " KB" << endl;
     
     return duration;
 }
@@ -47,7 +47,14 @@ int main() {
     cout << "Testing SystemAlloc..." << endl;
     void* sysPtr = SystemAlloc(1);  // 申请1页
     cout << "SystemAlloc got ptr: " << (sysPtr != nullptr) << endl;
-    SystemFree(sysPtr);
+    assert(((size_t)sysPtr & ((1 << PAGE_SHIFT) - 1)) == 0);  // 起始地址必须按页对齐
+    *(char*)sysPtr = 1;  // 能正常读写
+    SystemFree(sysPtr, 1);
+    
+    // 128页的申请同样要按页对齐
+    void* bigPtr = SystemAlloc(128);
+    assert(((size_t)bigPtr & ((1 << PAGE_SHIFT) - 1)) == 0);
+    SystemFree(bigPtr, 128);
     
     cout << "All tests passed" << endl;
     
@@ -27,7 +27,7 @@ void TestSmallObject() {
 }
 
 void TestLargeObject() {
-    cout << "=== 测试2: 大对象分配（直接malloc） ===" << endl;
+    cout << "=== 测试2: 大对象分配（PageCache按页分配） ===" << endl;
     
     // 分配大对象（>256KB）
     void* bigPtr1 = ConcurrentAlloc(512 * 1024);  // 512KB
@@ -51,9 +51,9 @@ void TestBoundary() {
     void* ptr1 = ConcurrentAlloc(256 * 1024);
     cout << "256KB（内存池）: " << ptr1 << endl;
     
-    // 超过256KB（走malloc）
+    // 超过256KB（走PageCache）
     void* ptr2 = ConcurrentAlloc(256 * 1024 + 1);
-    cout << "256KB+1（malloc）: " << ptr2 << endl;
+    cout << "256KB+1（PageCache）: " << ptr2 << endl;
     
     ConcurrentFree(ptr1, 256 * 1024);
     ConcurrentFree(ptr2, 256 * 1024 + 1);
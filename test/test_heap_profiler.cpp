@@ -0,0 +1,340 @@
+// 采样堆分析测试 - SetHeapSampleRate / DumpHeapProfile
+// 正确性：关闭时不采样；开启后profile按pprof的公式还原的总量和实际还在用的字节数接近、调用栈能对上分配的函数；
+//         各种释放路径（带size、不带size、批量、realloc）都能删掉采样；PoolAllocator/ConcurrentNew、批量分配、
+//         指定节点分配也会被采样；多线程；Span全部还回PageCache
+// 性能：关闭采样和开启采样（512KB）时的分配+释放（ns/对）
+//   g++ -std=c++17 -O2 -pthread -g test/test_heap_profiler.cpp src/CentralCache.cpp src/PageCache.cpp -o heap_profiler
+#include "../src/ConcurrentMemoryPool.h"
+#include "../src/PoolAllocator.h"
+#include "TestUtil.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* PROFILE_PATH = "/tmp/test_heap_profiler.prof";
+
+// 解析出来的profile：每行一个调用栈
+struct ProfileEntry {
+    size_t count;
+    size_t bytes;
+    vector<uintptr_t> stack;
+};
+
+struct Profile {
+    size_t rate = 0;
+    vector<ProfileEntry> entries;
+    bool hasMaps = false;
+};
+
+static Profile ReadProfile(const char* path) {
+    Profile profile;
+    ifstream in(path);
+    string line;
+    getline(in, line);
+    size_t objs, bytes, objs2, bytes2;
+    int matched = sscanf(line.c_str(), "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu", &objs, &bytes, &objs2,
+                         &bytes2, &profile.rate);
+    assert(matched == 5);
+    size_t totalObjs = 0, totalBytes = 0;
+    while (getline(in, line) && !line.empty()) {
+        ProfileEntry e;
+        matched = sscanf(line.c_str(), "%zu: %zu [", &e.count, &e.bytes);
+        assert(matched == 2);
+        istringstream addrs(line.substr(line.find('@') + 1));
+        string addr;
+        while (addrs >> addr) {
+            e.stack.push_back(stoull(addr, nullptr, 16));
+        }
+        totalObjs += e.count;
+        totalBytes += e.bytes;
+        profile.entries.push_back(e);
+    }
+    assert(totalObjs == objs && totalBytes == bytes);
+    getline(in, line);
+    profile.hasMaps = line == "MAPPED_LIBRARIES:";
+    return profile;
+}
+
+// pprof还原采样的方法：大小为s的分配被采到的概率是1-exp(-s/rate)，每个采样代表1/概率个分配
+static double Unsample(const ProfileEntry& e, size_t rate) {
+    double avg = (double)e.bytes / e.count;
+    return e.bytes / (1 - exp(-avg / rate));
+}
+
+// 调用栈里有没有落在函数fn里的地址（fn的代码不会超过1KB，也不会越过紧跟在后面的函数other）
+static bool StackContains(const ProfileEntry& e, void* fn, void* other) {
+    uintptr_t end = (uintptr_t)fn + 1024;
+    if ((uintptr_t)other > (uintptr_t)fn && (uintptr_t)other < end) {
+        end = (uintptr_t)other;
+    }
+    for (uintptr_t addr : e.stack) {
+        if (addr > (uintptr_t)fn && addr < end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 分配经过一层不内联的函数，LeakyA/LeakyB本身很短，调用栈里的返回地址一定落在它们的前1KB里
+POOL_NOINLINE void* AllocFrom(size_t size) {
+    return ConcurrentAlloc(size);
+}
+
+POOL_NOINLINE void LeakyA(void** out) {
+    for (int i = 0; i < 40000; ++i) {
+        out[i] = AllocFrom(256);  // 10MB
+    }
+}
+
+POOL_NOINLINE void LeakyB(void** out) {
+    for (int i = 0; i < 100; ++i) {
+        out[i] = AllocFrom(300 * 1024);  // 30MB大内存
+    }
+}
+
+void TestDisabled() {
+    cout << "=== 测试1: 默认关闭 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    assert(GetHeapSampleRate() == 0);
+    vector<void*> ptrs;
+    for (int i = 0; i < 100000; ++i) {
+        ptrs.push_back(ConcurrentAlloc(1000));
+    }
+    assert(HeapProfiler::GetInstance()->GetLiveSamples() == 0);
+    for (void* p : ptrs) {
+        ConcurrentFree(p, 1000);
+    }
+    assert(DumpHeapProfile(PROFILE_PATH));
+    Profile profile = ReadProfile(PROFILE_PATH);
+    assert(profile.entries.empty() && profile.hasMaps);
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+void TestProfile() {
+    cout << "=== 测试2: 采样还原的总量和调用栈 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    SetHeapSampleRate(64 * 1024);
+    vector<void*> a(40000), b(100);
+    LeakyA(a.data());
+    LeakyB(b.data());
+    assert(HeapProfiler::GetInstance()->GetLiveSamples() > 0);
+    assert(DumpHeapProfile(PROFILE_PATH));
+
+    Profile profile = ReadProfile(PROFILE_PATH);
+    assert(profile.rate == 64 * 1024 && profile.hasMaps);
+    double totalA = 0, totalB = 0;
+    for (const ProfileEntry& e : profile.entries) {
+        if (StackContains(e, (void*)&LeakyA, (void*)&LeakyB)) {
+            totalA += Unsample(e, profile.rate);
+        }
+        else if (StackContains(e, (void*)&LeakyB, (void*)&LeakyA)) {
+            totalB += Unsample(e, profile.rate);
+        }
+    }
+    double realA = 40000 * 256.0, realB = 100 * 300 * 1024.0;
+    cout << "  LeakyA: 实际 " << realA / 1024 << " KB, 还原 " << totalA / 1024 << " KB" << endl;
+    cout << "  LeakyB: 实际 " << realB / 1024 << " KB, 还原 " << totalB / 1024 << " KB" << endl;
+    assert(fabs(totalA - realA) < realA * 0.3);
+    assert(fabs(totalB - realB) < realB * 0.3);
+
+    // 采样的对象照常读写
+    for (void* p : a) {
+        memset(p, 1, 256);
+    }
+
+    // 各种释放路径
+    for (size_t i = 0; i < a.size(); i += 4) {
+        ConcurrentFree(a[i], 256);
+        ConcurrentFree(a[i + 1]);
+        a[i + 2] = ConcurrentRealloc(a[i + 2], 256, 5000);
+        ConcurrentFree(a[i + 2], 5000);
+        a[i + 3] = ConcurrentRealloc(a[i + 3], 200);
+        ConcurrentFree(a[i + 3]);
+    }
+    ConcurrentFreeBatch(b.data(), b.size() / 2, 300 * 1024);
+    for (size_t i = b.size() / 2; i < b.size(); ++i) {
+        b[i] = ConcurrentRealloc(b[i], 300 * 1024, 600 * 1024);
+        ConcurrentFree(b[i], 600 * 1024);
+    }
+    vector<void*> batch(1000);
+    ConcurrentAllocBatch(64, batch.size() - 100, batch.data() + 100);
+    for (size_t i = 0; i < 100; ++i) {
+        batch[i] = ConcurrentAlloc(64);  // 混进可能被采样的对象
+    }
+    ConcurrentFreeBatch(batch.data() + 100, batch.size() - 100, 64);
+    ConcurrentFreeBatch(batch.data(), 100, 64);
+
+    SetHeapSampleRate(0);
+    assert(HeapProfiler::GetInstance()->GetLiveSamples() == 0);
+    assert(DumpHeapProfile(PROFILE_PATH));
+    assert(ReadProfile(PROFILE_PATH).entries.empty());
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+// profile里平均大小正好是size的调用栈还原出来的总量（各接口用不同的对象大小区分）
+static double UnsampledBytes(const Profile& profile, size_t size) {
+    double total = 0;
+    for (const ProfileEntry& e : profile.entries) {
+        if (e.bytes == e.count * size) {
+            total += Unsample(e, profile.rate);
+        }
+    }
+    return total;
+}
+
+struct Obj208 {
+    char data[208];  // 正好是一个size class，按索引分配时采样记录的大小就是208
+};
+
+void TestOtherPaths() {
+    cout << "=== 测试3: PoolAllocator/ConcurrentNew、批量分配、指定节点分配的采样 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    SetHeapSampleRate(64 * 1024);
+    const size_t count = 40000;
+    PoolAllocator<Obj208> alloc;
+    vector<Obj208*> objs(count);
+    for (size_t i = 0; i < count; ++i) {
+        objs[i] = i % 2 ? alloc.allocate(1) : ConcurrentNew<Obj208>();
+    }
+    vector<void*> batch(count);
+    for (size_t i = 0; i < count; i += 1000) {
+        ConcurrentAllocBatch(304, 1000, batch.data() + i);
+    }
+    vector<void*> onNode(count);
+    for (size_t i = 0; i < count; ++i) {
+        onNode[i] = ConcurrentAllocOnNode(400, 0);
+        assert(ConcurrentNodeOf(onNode[i]) == 0);  // 被采样的也在指定节点上
+    }
+
+    assert(DumpHeapProfile(PROFILE_PATH));
+    Profile profile = ReadProfile(PROFILE_PATH);
+    double realIndex = count * 208.0, realBatch = count * 304.0, realNode = count * 400.0;
+    double totalIndex = UnsampledBytes(profile, 208);
+    double totalBatch = UnsampledBytes(profile, 304);
+    double totalNode = UnsampledBytes(profile, 400);
+    cout << "  PoolAllocator/ConcurrentNew: 实际 " << realIndex / 1024 << " KB, 还原 " << totalIndex / 1024 << " KB"
+         << endl;
+    cout << "  ConcurrentAllocBatch: 实际 " << realBatch / 1024 << " KB, 还原 " << totalBatch / 1024 << " KB" << endl;
+    cout << "  ConcurrentAllocOnNode: 实际 " << realNode / 1024 << " KB, 还原 " << totalNode / 1024 << " KB" << endl;
+    assert(fabs(totalIndex - realIndex) < realIndex * 0.3);
+    assert(fabs(totalBatch - realBatch) < realBatch * 0.3);
+    assert(fabs(totalNode - realNode) < realNode * 0.3);
+
+    // 按索引释放、批量释放也要认出采样对象
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 2) {
+            alloc.deallocate(objs[i], 1);
+        }
+        else {
+            ConcurrentDelete(objs[i]);
+        }
+    }
+    ConcurrentFreeBatch(batch.data(), count, 304);
+    for (void* p : onNode) {
+        ConcurrentFree(p);
+    }
+
+    SetHeapSampleRate(0);
+    assert(HeapProfiler::GetInstance()->GetLiveSamples() == 0);
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+void TestMultiThread() {
+    cout << "=== 测试4: 多线程采样，跨线程释放 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    SetHeapSampleRate(16 * 1024);
+    const size_t threadCount = 8;
+    vector<vector<void*>> survivors(threadCount);
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([t, &survivors]() {
+            SetHeapSampleRate(16 * 1024);  // 让本线程立即生效
+            size_t sizes[] = {8, 100, 1500, 9000, 270 * 1024};
+            for (size_t r = 0; r < 20000; ++r) {
+                size_t size = sizes[(r + t) % 5];
+                void* p = ConcurrentAlloc(size);
+                if (r % 10 == 0) {
+                    survivors[t].push_back(p);
+                }
+                else {
+                    ConcurrentFree(p, size);
+                }
+            }
+        });
+    }
+    // 运行中随时可以dump
+    for (int i = 0; i < 10; ++i) {
+        assert(DumpHeapProfile(PROFILE_PATH));
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    assert(DumpHeapProfile(PROFILE_PATH));
+    Profile profile = ReadProfile(PROFILE_PATH);
+    size_t samples = 0;
+    for (const ProfileEntry& e : profile.entries) {
+        samples += e.count;
+    }
+    assert(samples == HeapProfiler::GetInstance()->GetLiveSamples() && samples > 0);
+
+    for (auto& v : survivors) {
+        for (void* p : v) {
+            ConcurrentFree(p);
+        }
+    }
+    SetHeapSampleRate(0);
+    assert(HeapProfiler::GetInstance()->GetLiveSamples() == 0);
+    CheckBaseline(baseline);
+    cout << samples << "个采样 OK" << endl << endl;
+}
+
+// 单线程rounds对分配+释放，返回ns/对
+static double Benchmark(size_t size) {
+    const size_t rounds = 5000000;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        void* p = ConcurrentAlloc(size);
+        ConcurrentFree(p, size);
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / rounds;
+}
+
+void TestPerformance() {
+    cout << "=== 测试5: 采样的开销（分配+释放，ns/对） ===" << endl;
+
+    for (size_t size : {16, 1024}) {
+        SetHeapSampleRate(0);
+        double off = Benchmark(size);
+        SetHeapSampleRate(512 * 1024);
+        double on = Benchmark(size);
+        SetHeapSampleRate(0);
+        cout << "  " << size << "字节: 关闭 " << off << " ns, 开启(512KB) " << on << " ns" << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestDisabled();
+    TestProfile();
+    TestOtherPaths();
+    TestMultiThread();
+    TestPerformance();
+
+    remove(PROFILE_PATH);
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,144 @@
+// 大内存测试 - 超过256KB的内存按整页Span由PageCache分配、缓存、合并
+// 超过DIRECT_MMAP_PAGES页的才直接mmap/munmap
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+// 释放后再申请同样大小，应该复用缓存的Span（地址相同），不再向系统申请
+void TestReuse() {
+    cout << "=== 测试2: 大Span复用 ===" << endl;
+
+    size_t sizes[] = {300 * 1024, 1024 * 1024, 2 * 1024 * 1024 + 100, 4 * 1024 * 1024};
+    for (size_t size : sizes) {
+        void* p1 = ConcurrentAlloc(size);
+        memset(p1, 1, size);
+        ConcurrentFree(p1, size);
+        void* p2 = ConcurrentAlloc(size);
+        assert(p1 == p2);
+        ConcurrentFree(p2);
+        cout << size << "字节: 复用 OK" << endl;
+    }
+    cout << endl;
+}
+
+// 相邻的两个大Span释放后合并，可以满足两者之和大小的申请
+void TestCoalesce() {
+    cout << "=== 测试1: 相邻大Span合并 ===" << endl;
+
+    const size_t size = 2 * 1024 * 1024;
+    const size_t kpage = size >> PAGE_SHIFT;
+    if (kpage * 2 > DIRECT_MMAP_PAGES) {
+        cout << "超过直接mmap的阈值，不缓存，跳过" << endl << endl;
+        return;
+    }
+    // 先申请释放一个两倍大小的Span，后面两次申请都从它切出来，保证相邻
+    // （要求此时没有其他缓存的大Span，所以放在最前面测）
+    void* whole = ConcurrentAlloc(size * 2);
+    ConcurrentFree(whole);
+    void* a = ConcurrentAlloc(size);
+    void* b = ConcurrentAlloc(size);
+    assert(a == whole && (char*)b == (char*)a + size);
+    ConcurrentFree(a);
+    ConcurrentFree(b);
+
+    void* c = ConcurrentAlloc(size * 2);
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(c);
+    assert(span->_n == kpage * 2);
+    assert(c == a);
+    ConcurrentFree(c);
+    cout << "两个" << kpage << "页合并成" << kpage * 2 << "页 OK" << endl << endl;
+}
+
+// 超过阈值的直接mmap，释放后页数回到原来
+void TestDirectMmap() {
+    cout << "=== 测试3: 超过阈值直接mmap ===" << endl;
+
+    size_t before = PageCache::GetInstance()->GetUsePages();
+    size_t size = ((size_t)DIRECT_MMAP_PAGES + 1) << PAGE_SHIFT;
+    char* p = (char*)ConcurrentAlloc(size);
+    p[0] = 1;
+    p[size - 1] = 1;
+    assert(PageCache::GetInstance()->MapObjectToSpan(p + size - 1)->_n == DIRECT_MMAP_PAGES + 1);
+    ConcurrentFree(p);
+    // 还给系统后映射已经清掉
+    assert(PageCache::GetInstance()->MapObjectToSpan(p) == nullptr);
+    assert(PageCache::GetInstance()->GetUsePages() == before);
+    cout << (size >> 20) << "MB: 直接mmap OK" << endl << endl;
+}
+
+// 大Span缓存也能切给小对象用
+void TestSplitForSmall() {
+    cout << "=== 测试4: 大Span切给小对象 ===" << endl;
+
+    void* big = ConcurrentAlloc(8 * 1024 * 1024);
+    ConcurrentFree(big);
+    vector<void*> ptrs;
+    for (int i = 0; i < 10000; ++i) {
+        ptrs.push_back(ConcurrentAlloc(1024));
+    }
+    for (void* p : ptrs) {
+        ConcurrentFree(p, 1024);
+    }
+    cout << "小对象分配 OK" << endl << endl;
+}
+
+// 300KB-4MB缓冲区反复申请释放，对比malloc
+void TestBufferWorkload(size_t threadCount) {
+    cout << "=== 测试5: " << threadCount << "线程 300KB-4MB缓冲区 ===" << endl;
+
+    const size_t rounds = 2000;
+    auto work = [](bool usePool) {
+        size_t seed = 42;
+        vector<pair<void*, size_t>> live;
+        for (size_t r = 0; r < rounds; ++r) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t size = 300 * 1024 + (seed >> 33) % (4 * 1024 * 1024 - 300 * 1024);
+            void* p = usePool ? ConcurrentAlloc(size) : malloc(size);
+            // 只写首尾，模拟只用到一部分的缓冲区
+            ((char*)p)[0] = 1;
+            ((char*)p)[size - 1] = 1;
+            live.push_back({p, size});
+            if (live.size() > 4) {
+                if (usePool) ConcurrentFree(live.front().first, live.front().second);
+                else free(live.front().first);
+                live.erase(live.begin());
+            }
+        }
+        for (auto& kv : live) {
+            if (usePool) ConcurrentFree(kv.first, kv.second);
+            else free(kv.first);
+        }
+    };
+
+    long long ms[2];
+    for (int usePool = 0; usePool < 2; ++usePool) {
+        auto start = chrono::high_resolution_clock::now();
+        vector<thread> threads;
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back(work, usePool == 1);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        auto end = chrono::high_resolution_clock::now();
+        ms[usePool] = chrono::duration_cast<chrono::milliseconds>(end - start).count();
+    }
+
+    cout << "malloc耗时: " << ms[0] << " ms" << endl;
+    cout << "内存池耗时: " << ms[1] << " ms" << endl << endl;
+}
+
+int main() {
+    TestCoalesce();
+    TestReuse();
+    TestDirectMmap();
+    TestSplitForSmall();
+    TestBufferWorkload(1);
+    TestBufferWorkload(4);
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,121 @@
+// 按需切分Span测试 - 新Span不再一次性切成链表
+// 场景1：反复拿到新Span只取一个对象，看每次的延迟（旧实现每次都要把整个Span写一遍）
+// 场景2：很少使用的size class，每种只要一个对象，看缺页次数和RSS
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+#include <sys/resource.h>
+
+using namespace std;
+
+static long MinorFaults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+// 从/proc/self/statm读常驻内存页数（系统页，4KB）
+static size_t ResidentPages() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    size_t total = 0, resident = 0;
+    if (f != nullptr) {
+        if (fscanf(f, "%zu %zu", &total, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident;
+}
+
+void TestRarelyUsedClasses() {
+    cout << "=== 场景2: 每个size class只用一个对象 ===" << endl;
+
+    // 先把PageCache的元数据和第一块系统内存碰一下，不计入统计
+    void* warm = ConcurrentAlloc(MAX_BYTES);
+    ConcurrentFree(warm, MAX_BYTES);
+
+    long faults0 = MinorFaults();
+    size_t rss0 = ResidentPages();
+
+    vector<pair<void*, size_t>> ptrs;
+    for (size_t size = 8; size <= 1024; size += 8) {
+        void* p = ConcurrentAlloc(size);
+        *(char*)p = 1;
+        ptrs.push_back({p, size});
+    }
+
+    long faults = MinorFaults() - faults0;
+    size_t rss = ResidentPages() - rss0;
+    cout << ptrs.size() << "种大小各1个对象: 缺页 " << faults << " 次, RSS增加 "
+         << rss * 4 << " KB" << endl;
+
+    for (auto& kv : ptrs) {
+        ConcurrentFree(kv.first, kv.second);
+    }
+    cout << endl;
+}
+
+void TestFreshSpanLatency(size_t size, size_t rounds) {
+    // 直接调用CentralCache，取一个对象后马上还回去，
+    // Span的对象全部还回来会归还PageCache，下一次又是新Span
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        void* objStart = nullptr;
+        void* objEnd = nullptr;
+        size_t n = CentralCache::GetInstance()->FetchRangeObj(objStart, objEnd, size, 1);
+        assert(n == 1 && objStart == objEnd);
+        CentralCache::GetInstance()->ReleaseListToSpans(objStart, size);
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << size << "字节，新Span取1个对象 x " << rounds << "次: 每次 "
+         << (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / rounds
+         << " ns" << endl;
+}
+
+// 按需切分和还回来的对象混在一起时，分配出去的对象不能重复
+void TestMixedCarveAndReuse() {
+    cout << "=== 场景3: 切分与复用混合 ===" << endl;
+
+    const size_t size = 48;
+    vector<void*> ptrs;
+    for (int i = 0; i < 10000; ++i) {
+        ptrs.push_back(ConcurrentAlloc(size));
+    }
+    // 释放一部分，再分配，还回来的和新切的对象混着用
+    for (size_t i = 0; i < ptrs.size(); i += 3) {
+        ConcurrentFree(ptrs[i], size);
+        ptrs[i] = nullptr;
+    }
+    for (size_t i = 0; i < ptrs.size(); i += 3) {
+        ptrs[i] = ConcurrentAlloc(size);
+    }
+    for (int i = 0; i < 5000; ++i) {
+        ptrs.push_back(ConcurrentAlloc(size));
+    }
+
+    vector<void*> sorted = ptrs;
+    sort(sorted.begin(), sorted.end());
+    for (size_t i = 1; i < sorted.size(); ++i) {
+        assert((char*)sorted[i] >= (char*)sorted[i - 1] + size);
+    }
+    for (void* p : ptrs) {
+        ConcurrentFree(p, size);
+    }
+    cout << ptrs.size() << "个对象互不重叠 OK" << endl << endl;
+}
+
+int main() {
+    // 场景1要求对应的size class里没有别的Span，放在最前面跑
+    cout << "=== 场景1: 新Span首次分配延迟 ===" << endl;
+    TestFreshSpanLatency(8, 100000);
+    TestFreshSpanLatency(64, 100000);
+    TestFreshSpanLatency(1024, 100000);
+    cout << endl;
+
+    TestRarelyUsedClasses();
+    TestMixedCarveAndReuse();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,171 @@
+// 锁竞争统计测试 - ProfiledMutex / GetLockProfile / PrintLockProfile
+// 正确性：加锁次数和直方图对得上、单线程没有竞争、多个线程抢同一把锁时能看到竞争和等待时间、
+//         内存池的桶锁/槽位锁/分片锁都有统计
+// 性能：std::mutex和ProfiledMutex一次加解锁的耗时
+// 需要开启ENABLE_LOCK_PROFILE（或ENABLE_STATS）才统计内存池的锁（没开启时只测ProfiledMutex本身）：
+//   g++ -std=c++17 -O2 -pthread -DENABLE_LOCK_PROFILE test/test_lock_profile.cpp src/CentralCache.cpp src/PageCache.cpp -o lock_profile
+#include "../src/ConcurrentMemoryPool.h"
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+static uint64_t HistSum(const uint64_t (&hist)[LOCK_HIST_BUCKETS]) {
+    uint64_t sum = 0;
+    for (uint64_t n : hist) {
+        sum += n;
+    }
+    return sum;
+}
+
+// 所有线程都停下来时，每把锁的两个直方图的总数都等于加锁次数
+static void CheckConsistent(const LockStats& s) {
+    assert(HistSum(s.waitHist) == s.acquisitions);
+    assert(HistSum(s.holdHist) == s.acquisitions);
+    assert(s.contended <= s.acquisitions);
+    assert(s.contended > 0 || s.waitNs == 0);
+}
+
+void TestMutex() {
+    cout << "=== 测试1: ProfiledMutex ===" << endl;
+
+    assert(LockHistBucket(0) == 0 && LockHistBucket(63) == 0);
+    assert(LockHistBucket(64) == 1 && LockHistBucket(127) == 1 && LockHistBucket(128) == 2);
+    assert(LockHistBucket((uint64_t)1 << 40) == LOCK_HIST_BUCKETS - 1);
+
+    ProfiledMutex mtx;
+    for (int i = 0; i < 1000; ++i) {
+        std::lock_guard<ProfiledMutex> lock(mtx);
+    }
+    assert(mtx.try_lock());
+    this_thread::sleep_for(chrono::milliseconds(2));
+    mtx.unlock();
+
+    LockStats s;
+    s.Add(mtx.Counters());
+    CheckConsistent(s);
+    assert(s.acquisitions == 1001 && s.contended == 0);
+    assert(s.holdHist[LOCK_HIST_BUCKETS - 1] >= 1);  // 睡了2ms的那次
+    assert(LockHistPercentile(s.holdHist, 0.5) <= 1024);
+
+    // 一个线程拿着锁不放，另一个线程必须等
+    mtx.lock();
+    thread waiter([&mtx]() {
+        std::lock_guard<ProfiledMutex> lock(mtx);
+    });
+    this_thread::sleep_for(chrono::milliseconds(20));
+    mtx.unlock();
+    waiter.join();
+
+    LockStats s2;
+    s2.Add(mtx.Counters());
+    CheckConsistent(s2);
+    assert(s2.acquisitions == 1003 && s2.contended == 1);
+    assert(s2.waitNs >= 1000 * 1000);  // 等待线程启动后至少等了1ms以上
+    assert(s2.waitHist[LOCK_HIST_BUCKETS - 1] == 1);
+    cout << "OK" << endl << endl;
+}
+
+void TestPool() {
+    cout << "=== 测试2: 内存池的锁 ===" << endl;
+
+    LockProfile p0 = GetLockProfile();
+#ifdef ENABLE_LOCK_PROFILE
+    assert(p0.enabled);
+#else
+    assert(!p0.enabled);
+#endif
+
+    // 多个线程反复把对象还回CentralCache，桶锁、槽位锁、分片锁都会用到
+    const size_t threadCount = 8;
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([]() {
+            size_t sizes[] = {16, 128, 4096, 64 * 1024};
+            for (int r = 0; r < 200; ++r) {
+                vector<void*> ptrs;
+                for (int i = 0; i < 500; ++i) {
+                    ptrs.push_back(ConcurrentAlloc(sizes[i % 4]));
+                }
+                for (int i = 0; i < 500; ++i) {
+                    ConcurrentFree(ptrs[i], sizes[i % 4]);
+                }
+#ifndef PERCPU_RSEQ
+                GetTLSThreadCache()->ReleaseAll();
+#endif
+            }
+        });
+    }
+    // 运行中也能随时汇总
+    for (int i = 0; i < 10; ++i) {
+        GetLockProfile();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    LockProfile p1 = GetLockProfile();
+    for (size_t i = 0; i < NFREELIST; ++i) {
+        CheckConsistent(p1.central[i]);
+        CheckConsistent(p1.transfer[i]);
+    }
+    for (size_t i = 0; i < PAGE_CACHE_TOTAL_SHARDS; ++i) {
+        CheckConsistent(p1.page[i]);
+    }
+#ifdef ENABLE_LOCK_PROFILE
+    size_t index = SizeClass::Index(64 * 1024);
+    assert(p1.central[index].acquisitions > p0.central[index].acquisitions);
+    uint64_t pageAcquisitions = 0;
+    for (const LockStats& s : p1.page) {
+        pageAcquisitions += s.acquisitions;
+    }
+    assert(pageAcquisitions > 0);
+#endif
+
+    PrintLockProfile(p1, 8);
+    cout << endl;
+}
+
+// threadCount个线程各对同一把锁做rounds次加解锁，返回ns/次
+template <class Mutex>
+static double Benchmark(size_t threadCount) {
+    const size_t rounds = 2000000;
+    Mutex mtx;
+    uint64_t counter = 0;
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&mtx, &counter]() {
+            for (size_t r = 0; r < rounds; ++r) {
+                std::lock_guard<Mutex> lock(mtx);
+                ++counter;
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    auto end = chrono::high_resolution_clock::now();
+    assert(counter == threadCount * rounds);
+    return (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (threadCount * rounds);
+}
+
+void TestPerformance() {
+    cout << "=== 测试3: 一次加解锁的耗时（ns） ===" << endl;
+
+    for (size_t threadCount : {1, 4}) {
+        cout << "  " << threadCount << "线程: std::mutex " << Benchmark<std::mutex>(threadCount)
+             << " ns, ProfiledMutex " << Benchmark<ProfiledMutex>(threadCount) << " ns" << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestMutex();
+    TestPool();
+    TestPerformance();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
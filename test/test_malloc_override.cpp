@@ -0,0 +1,201 @@
+// malloc替换库测试 - 不直接链接内存池，通过LD_PRELOAD注入libconcurrentmalloc.so后运行
+//   g++ -std=c++17 -O2 -fPIC -shared -fvisibility=hidden -ftls-model=initial-exec
+//       src/MallocOverride.cpp src/CentralCache.cpp src/PageCache.cpp -o libconcurrentmalloc.so -pthread
+//   g++ -std=c++17 -O2 test/test_malloc_override.cpp -o test_malloc_override -pthread
+//   LD_PRELOAD=./libconcurrentmalloc.so ./test_malloc_override
+// 不注入时跑的是glibc，可以用来做A/B对比
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <list>
+#include <thread>
+#include <chrono>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <assert.h>
+#include <atomic>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+void TestCApi() {
+    cout << "=== 测试1: C接口 ===" << endl;
+
+    // malloc/free，检查16字节对齐
+    for (size_t size = 0; size < 2000; size += 7) {
+        char* p = (char*)malloc(size);
+        assert(p != nullptr);
+        assert(((size_t)p & 15) == 0);
+        assert(malloc_usable_size(p) >= size);
+        memset(p, 0xab, size);
+        free(p);
+    }
+
+    // calloc必须清零，即使拿到的是之前用过的内存
+    char* dirty = (char*)malloc(256);
+    memset(dirty, 0xff, 256);
+    free(dirty);
+    char* clean = (char*)calloc(16, 16);
+    for (int i = 0; i < 256; ++i) {
+        assert(clean[i] == 0);
+    }
+    free(clean);
+
+    // realloc扩容要保留原内容
+    char* p = (char*)malloc(10);
+    strcpy(p, "hello");
+    for (size_t size = 16; size < 4 * 1024 * 1024; size *= 2) {
+        p = (char*)realloc(p, size);
+        assert(strcmp(p, "hello") == 0);
+    }
+    free(p);
+
+    // 对齐分配
+    size_t aligns[] = {32, 64, 256, 4096, 8192, 64 * 1024, 2 * 1024 * 1024};
+    for (size_t align : aligns) {
+        void* q = nullptr;
+        assert(posix_memalign(&q, align, 100) == 0);
+        assert(((size_t)q & (align - 1)) == 0);
+        memset(q, 1, 100);
+        free(q);
+
+        void* r = aligned_alloc(align, align * 2);
+        assert(((size_t)r & (align - 1)) == 0);
+        memset(r, 1, align * 2);
+        free(r);
+    }
+
+    // memalign的alignment不是2的幂时按下一个2的幂对齐（glibc的行为）
+    void* m = memalign(24, 100);
+    assert(m != nullptr);
+    assert(((size_t)m & 31) == 0);
+    free(m);
+
+    // 大内存
+    char* big = (char*)malloc(10 * 1024 * 1024);
+    memset(big, 1, 10 * 1024 * 1024);
+    free(big);
+
+    cout << "malloc_usable_size(malloc(1)) = " << malloc_usable_size(malloc(1))
+         << "（内存池为16，glibc为24）" << endl;
+    cout << "C接口 OK" << endl << endl;
+}
+
+struct alignas(128) AlignedNode {
+    char data[100];
+};
+
+void TestCxxApi() {
+    cout << "=== 测试2: C++ new/delete ===" << endl;
+
+    int* a = new int(42);
+    delete a;
+    int* arr = new int[1000];
+    delete[] arr;
+
+    AlignedNode* node = new AlignedNode;
+    assert(((size_t)node & 127) == 0);
+    delete node;
+
+    AlignedNode* nodes = new AlignedNode[10];
+    assert(((size_t)nodes & 127) == 0);
+    delete[] nodes;
+
+    void* nothrowPtr = ::operator new(64, std::nothrow);
+    ::operator delete(nothrowPtr);
+
+    // STL容器
+    map<int, string> m;
+    list<string> l;
+    for (int i = 0; i < 100000; ++i) {
+        m[i] = to_string(i) + "_value_with_some_length";
+        l.push_back(m[i]);
+    }
+    for (int i = 0; i < 100000; i += 2) {
+        m.erase(i);
+    }
+    assert(m.size() == 50000);
+    assert(l.size() == 100000);
+
+    cout << "C++接口 OK" << endl << endl;
+}
+
+void ThreadTask(int id) {
+    vector<string> strs;
+    for (int r = 0; r < 50; ++r) {
+        for (int i = 0; i < 1000; ++i) {
+            strs.push_back(string(16 + (i * 37 + id) % 3000, 'x'));
+        }
+        strs.clear();
+        strs.shrink_to_fit();
+    }
+}
+
+void TestMultiThread() {
+    cout << "=== 测试3: 多线程 ===" << endl;
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back(ThreadTask, i);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << "8线程字符串分配耗时: "
+         << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+    cout << "多线程 OK" << endl << endl;
+}
+
+void TestFork() {
+    cout << "=== 测试4: 多线程时fork ===" << endl;
+
+    // 其他线程一直在申请释放大内存（每次都要拿PageCache的锁），fork出来的子进程不能继承一把被它们拿着的锁
+    atomic<bool> stop{false};
+    vector<thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&stop, i]() {
+            while (!stop.load(memory_order_relaxed)) {
+                void* p = malloc((size_t)(i + 1) * 512 * 1024);
+                free(p);
+            }
+        });
+    }
+    for (int r = 0; r < 200; ++r) {
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            vector<string> strs;
+            for (int i = 0; i < 1000; ++i) {
+                strs.push_back(string(16 + i * 37 % 3000, 'x'));
+            }
+            free(malloc(1024 * 1024));
+            _exit(0);
+        }
+        int status = 0;
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    cout << "fork OK" << endl << endl;
+}
+
+int main() {
+    TestCApi();
+    TestCxxApi();
+    TestMultiThread();
+    TestFork();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,194 @@
+// std::pmr接口测试 - PoolMemoryResource / SpanArena
+// 正确性：pmr容器正常工作、对齐、大块单独成Span、Release后Span全部还回PageCache、多线程各用各的SpanArena
+// 性能：模拟一个请求建很多小对象再整体丢弃，对比std::allocator、PoolMemoryResource、
+//       std::pmr::monotonic_buffer_resource和SpanArena（us/请求）
+//   g++ -std=c++17 -O2 -pthread test/test_memory_resource.cpp src/CentralCache.cpp src/PageCache.cpp -o memory_resource
+#include "../src/MemoryResource.h"
+#include "TestUtil.h"
+#include <chrono>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+void TestPoolResource() {
+    cout << "=== 测试1: PoolMemoryResource ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    std::pmr::memory_resource* mr = GetPoolMemoryResource();
+    {
+        std::pmr::map<int, std::pmr::string> m(mr);
+        for (int i = 0; i < 20000; ++i) {
+            m.emplace(i, to_string(i) + " 这个字符串足够长不会走小字符串优化");
+        }
+        for (int i = 0; i < 20000; i += 2) {
+            m.erase(i);
+        }
+        assert(m.size() == 10000 && m.at(9999).compare(0, 4, "9999") == 0);
+
+        std::pmr::vector<int> v(mr);
+        for (int i = 0; i < 200000; ++i) {  // 扩容一路从小对象涨到大内存
+            v.push_back(i);
+        }
+        assert(v[123456] == 123456);
+    }
+
+    // 各种对齐
+    size_t aligns[] = {1, 8, 16, 64, 4096, 16384, 65536};
+    for (size_t align : aligns) {
+        for (size_t size : {(size_t)1, (size_t)100, (size_t)5000, (size_t)300 * 1024}) {
+            void* p = mr->allocate(size, align);
+            assert(((uintptr_t)p & (align - 1)) == 0);
+            memset(p, 0x5a, size);
+            mr->deallocate(p, size, align);
+        }
+    }
+
+    // 不同实例等价
+    PoolMemoryResource other;
+    assert(mr->is_equal(other) && !mr->is_equal(*std::pmr::new_delete_resource()));
+
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+void TestArena() {
+    cout << "=== 测试2: SpanArena ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    {
+        SpanArena arena;
+        {
+            // 容器必须在Release之前析构
+            std::pmr::list<int> l(&arena);
+            std::pmr::map<int, int> m(&arena);
+            for (int i = 0; i < 100000; ++i) {
+                l.push_back(i);
+                m[i] = i;
+            }
+            assert(l.size() == 100000 && m.at(77777) == 77777);
+        }
+
+        // 对齐和顺序切分：相邻分配不重叠
+        char* prev = nullptr;
+        for (int i = 0; i < 1000; ++i) {
+            char* p = (char*)arena.allocate(24, 64);
+            assert(((uintptr_t)p & 63) == 0);
+            assert(prev == nullptr || p >= prev + 24 || p < prev);
+            memset(p, 1, 24);
+            prev = p;
+        }
+        // 大块和大对齐单独一个Span
+        void* big = arena.allocate(3 << 20, 8);
+        memset(big, 2, 3 << 20);
+        void* aligned = arena.allocate(100, 1 << 20);
+        assert(((uintptr_t)aligned & ((1 << 20) - 1)) == 0);
+
+        size_t before = arena.GetBytes();
+        assert(PageCache::GetInstance()->GetUsePages() - baseline == before >> PAGE_SHIFT);
+        arena.Release();
+        assert(arena.GetBytes() == 0);
+        assert(PageCache::GetInstance()->GetUsePages() == baseline);
+
+        // 刚被当成小对象Span用过又还回PageCache的Span，arena拿到后按大内存记录，不带着原来的size class
+        Span* used = PageCache::GetInstance()->NewSpan(8);
+        used->_objSize = 16;
+        PageCache::GetInstance()->ReleaseSpanToPageCache(used);
+        Span* span = PageCache::GetInstance()->MapObjectToSpan(arena.allocate(16));
+        assert(span->_objSize == span->_n << PAGE_SHIFT);
+        assert(span->_freeList == nullptr && span->_sample == nullptr);
+        arena.Release();
+
+        // Release之后还能继续用，析构时再还一次
+        {
+            std::pmr::vector<int> v(1000, 7, &arena);
+            assert(v.back() == 7);
+        }
+    }
+    assert(PageCache::GetInstance()->GetUsePages() == baseline);
+    cout << "OK" << endl << endl;
+}
+
+void TestMultiThread() {
+    cout << "=== 测试3: 多线程各用各的SpanArena ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            SpanArena arena;
+            for (int r = 0; r < 50; ++r) {
+                {
+                    std::pmr::map<int, int> m(&arena);
+                    for (int i = 0; i < 5000; ++i) {
+                        m[i] = i + t;
+                    }
+                    assert(m.at(4999) == 4999 + t);
+                }
+                arena.Release();
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    assert(PageCache::GetInstance()->GetUsePages() == baseline);
+    cout << "OK" << endl << endl;
+}
+
+// 一个“请求”：建一个n个节点的map和list，然后整体丢弃
+template <class Map, class List, class MakeAlloc, class Reset>
+double BenchmarkRequest(size_t n, MakeAlloc makeAlloc, Reset reset) {
+    const size_t rounds = 200;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        {
+            Map m(makeAlloc());
+            List l(makeAlloc());
+            for (size_t i = 0; i < n; ++i) {
+                m.emplace((i * 2654435761u) % n, i);
+                l.push_back(i);
+            }
+        }
+        reset();
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return (double)chrono::duration_cast<chrono::microseconds>(end - start).count() / rounds;
+}
+
+void TestPerformance() {
+    cout << "=== 测试4: 每个请求建map+list再整体丢弃（us/请求） ===" << endl;
+
+    using StdMap = map<size_t, size_t>;
+    using StdList = list<size_t>;
+    using PmrMap = std::pmr::map<size_t, size_t>;
+    using PmrList = std::pmr::list<size_t>;
+    auto noReset = []() {};
+
+    for (size_t n : {1000, 10000}) {
+        double stdAlloc = BenchmarkRequest<StdMap, StdList>(n, []() { return std::allocator<size_t>(); }, noReset);
+        double pool = BenchmarkRequest<PmrMap, PmrList>(
+            n, []() { return std::pmr::polymorphic_allocator<size_t>(GetPoolMemoryResource()); }, noReset);
+        std::pmr::monotonic_buffer_resource monotonic;
+        double mono = BenchmarkRequest<PmrMap, PmrList>(
+            n, [&]() { return std::pmr::polymorphic_allocator<size_t>(&monotonic); }, [&]() { monotonic.release(); });
+        SpanArena arena;
+        double span = BenchmarkRequest<PmrMap, PmrList>(
+            n, [&]() { return std::pmr::polymorphic_allocator<size_t>(&arena); }, [&]() { arena.Release(); });
+        cout << "  " << n << "个节点: std::allocator " << stdAlloc << " us, PoolMemoryResource " << pool
+             << " us, monotonic_buffer_resource " << mono << " us, SpanArena " << span << " us" << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestPoolResource();
+    TestArena();
+    TestMultiThread();
+    TestPerformance();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
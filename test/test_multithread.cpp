@@ -104,13 +104,8 @@ long long BenchmarkMalloc_MultiThread(size_t threadCount, size_t size, size_t ro
 long long BenchmarkMemoryPool_MultiThread(size_t threadCount, size_t size, size_t roundsPerThread) {
     cout << "\n【内存池多线程测试】线程数: " << threadCount << endl;
     
-#ifdef ENABLE_STATS
-    // 重置统计数据
-    g_allocCount.store(0);
-    g_freeCount.store(0);
-    g_currentMemory.store(0);
-    g_peakMemory.store(0);
-#endif
+    // 统计是累计值，记下开始时的值
+    PoolStats before = GetPoolStats();
     
     auto start = std::chrono::high_resolution_clock::now();
     
@@ -129,12 +124,11 @@ long long BenchmarkMemoryPool_MultiThread(size_t threadCount, size_t size, size_
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     
     cout << "内存池耗时: " << duration << " ms" << endl;
-#ifdef ENABLE_STATS
-    cout << "分配次数: " << g_allocCount.load() << endl;
-    cout << "释放次数: " << g_freeCount.load() << endl;
-    cout << "峰值内存: " << g_peakMemory.load() << " 字节 (" 
-         << (double)g_peakMemory.load() / 1024 / 1024 << " MB)" << endl;
-#endif
+    PoolStats after = GetPoolStats();
+    cout << "分配次数: " << after.allocCount - before.allocCount << endl;
+    cout << "释放次数: " << after.freeCount - before.freeCount << endl;
+    cout << "峰值内存: " << after.peakUseBytes << " 字节 (" 
+         << (double)after.peakUseBytes / 1024 / 1024 << " MB)" << endl;
     
     return duration;
 }
@@ -219,13 +213,6 @@ void CompareMultiThreadPerformance_Batch(size_t threadCount, size_t size, size_t
     
     // 测试内存池批量模式
     cout << "\n【内存池批量模式】" << endl;
-#ifdef ENABLE_STATS
-    g_allocCount.store(0);
-    g_freeCount.store(0);
-    g_currentMemory.store(0);
-    g_peakMemory.store(0);
-#endif
-    
     auto start2 = std::chrono::high_resolution_clock::now();
     vector<thread> threads2;
     for (size_t i = 0; i < threadCount; i++) {
@@ -238,10 +225,9 @@ void CompareMultiThreadPerformance_Batch(size_t threadCount, size_t size, size_t
     long long mempoolTime = std::chrono::duration_cast<std::chrono::milliseconds>(end2 - start2).count();
     
     cout << "内存池耗时: " << mempoolTime << " ms" << endl;
-#ifdef ENABLE_STATS
-    cout << "峰值内存: " << g_peakMemory.load() << " 字节 (" 
-         << (double)g_peakMemory.load() / 1024 / 1024 << " MB)" << endl;
-#endif
+    PoolStats stats = GetPoolStats();
+    cout << "峰值内存: " << stats.peakUseBytes << " 字节 (" 
+         << (double)stats.peakUseBytes / 1024 / 1024 << " MB)" << endl;
     
     // 计算性能提升
     cout << "\n【性能对比】" << endl;
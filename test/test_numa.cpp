@@ -0,0 +1,183 @@
+// NUMA测试 - 线程优先使用本节点的内存，指定节点分配，远端对象还回原节点
+// 真实NUMA机器：
+//   g++ -std=c++17 -O2 -pthread -DENABLE_NUMA test/test_numa.cpp src/CentralCache.cpp src/PageCache.cpp -o numa
+// 单节点机器上模拟2个节点（不调用mbind，只检查按节点分配的逻辑）：
+//   g++ -std=c++17 -O2 -pthread -DENABLE_NUMA -DNUMA_EMULATE_NODES=2 test/test_numa.cpp src/CentralCache.cpp src/PageCache.cpp -o numa
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+static size_t NodeCount() {
+    return NumaTopology::GetInstance()->NodeCount();
+}
+
+// 分配释放的线程都退出后（它们的ThreadCache随线程退出清空），再清空传输缓存，Span应该全部还回PageCache
+// 只看这些线程用过的内存，不清空调用线程自己的ThreadCache（和TestUtil.h的CheckBaseline不同）
+// per-CPU缓存的槽位不随线程退出清空，先把所有CPU的槽位弹空
+static void CheckBaselineAfterExit(size_t baseline) {
+#ifdef PERCPU_RSEQ
+    assert(PerCpuCache::GetInstance()->Drain());
+#endif
+    TransferCache::GetInstance()->Flush();
+    assert(PageCache::GetInstance()->GetUsePages() == baseline);
+}
+
+void TestTopology() {
+    cout << "=== 测试1: 节点拓扑 ===" << endl;
+#ifndef ENABLE_NUMA
+    cout << "没有开启ENABLE_NUMA，只有节点0" << endl;
+#elif defined(NUMA_EMULATE_NODES)
+    cout << "模拟模式，CPU按编号轮流分给各节点" << endl;
+#endif
+    cout << "节点数: " << NodeCount() << ", 当前线程所在节点: "
+         << NumaTopology::GetInstance()->CurrentNode() << endl << endl;
+}
+
+// 每个节点一个线程，分配的对象和大内存都应该来自本节点
+void TestLocalPlacement() {
+    cout << "=== 测试2: 本节点分配 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    for (size_t node = 0; node < NodeCount(); ++node) {
+        thread t([node]() {
+            assert(ConcurrentBindThreadToNode(node));
+            vector<pair<void*, size_t>> ptrs;
+            for (size_t i = 0; i < 20000; ++i) {
+                size_t size = 8 + (i * 37) % 2048;
+                ptrs.push_back({ConcurrentAlloc(size), size});
+            }
+            for (size_t i = 0; i < 8; ++i) {
+                size_t size = 300 * 1024 + i * 100 * 1024;
+                ptrs.push_back({ConcurrentAlloc(size), size});
+            }
+
+            size_t local = 0, physicalLocal = 0, physicalKnown = 0;
+            for (auto& kv : ptrs) {
+                *(char*)kv.first = 1;  // 访问一次，物理页才会分配
+                if (ConcurrentNodeOf(kv.first) == node) {
+                    ++local;
+                }
+                int physical = NumaTopology::GetInstance()->PhysicalNodeOf(kv.first);
+                if (physical >= 0) {
+                    ++physicalKnown;
+                    physicalLocal += (size_t)physical == node;
+                }
+            }
+            cout << "节点" << node << "的线程: " << ptrs.size() << "块内存, 分配器本地 "
+                 << local * 100 / ptrs.size() << "%";
+            if (physicalKnown > 0) {
+                cout << ", 物理页本地 " << physicalLocal * 100 / physicalKnown << "%";
+            }
+            else {
+                cout << ", 物理页位置查询不可用";
+            }
+            cout << endl;
+#ifndef PERCPU_RSEQ
+            // per-CPU缓存按CPU所在的节点取对象，模拟模式下绑定节点并不会换CPU，只检查ThreadCache
+            assert(local == ptrs.size());
+#endif
+
+            for (auto& kv : ptrs) {
+                ConcurrentFree(kv.first, kv.second);
+            }
+        });
+        t.join();
+    }
+    CheckBaselineAfterExit(baseline);
+    cout << "本节点分配 OK" << endl << endl;
+}
+
+// 指定节点分配，再由另一个节点的线程释放，对象要还回原节点
+void TestPinnedAndRemoteFree() {
+    cout << "=== 测试3: 指定节点分配、跨节点释放 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    size_t nodes = NodeCount();
+    vector<pair<void*, size_t>> ptrs;
+    thread producer([&ptrs, nodes]() {
+        ConcurrentBindThreadToNode(0);
+        for (size_t i = 0; i < 30000; ++i) {
+            size_t node = i % nodes;
+            size_t size = (i % 100 == 0) ? 512 * 1024 : 16 + (i * 13) % 1024;
+            void* p = ConcurrentAllocOnNode(size, node);
+            assert(ConcurrentNodeOf(p) == node);
+            *(size_t*)p = i;
+            ptrs.push_back({p, size});
+        }
+    });
+    producer.join();
+
+    thread consumer([&ptrs, nodes]() {
+        ConcurrentBindThreadToNode(nodes - 1);
+        for (size_t i = 0; i < ptrs.size(); ++i) {
+            assert(*(size_t*)ptrs[i].first == i);
+            ConcurrentFree(ptrs[i].first, ptrs[i].second);
+        }
+    });
+    consumer.join();
+
+    CheckBaselineAfterExit(baseline);
+    cout << nodes << "个节点，指定节点分配 " << ptrs.size() << " 块，跨节点释放 OK" << endl << endl;
+}
+
+// 节点0的线程遍历分别分配在本节点和远端节点上的链表，对比访问耗时
+void TestAccessLatency() {
+    cout << "=== 测试4: 本地/远端内存访问 ===" << endl;
+
+    struct Node {
+        Node* next;
+        char payload[56];
+    };
+    const size_t count = 1 << 20;
+    size_t nodes = NodeCount();
+    thread t([count, nodes]() {
+        ConcurrentBindThreadToNode(0);
+        for (size_t target = 0; target < nodes; ++target) {
+            vector<Node*> objs(count);
+            for (size_t i = 0; i < count; ++i) {
+                objs[i] = (Node*)ConcurrentAllocOnNode(sizeof(Node), target);
+            }
+            // 打乱顺序串成链表，避免预取掩盖访问延迟
+            size_t seed = 99;
+            for (size_t i = count - 1; i > 0; --i) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                swap(objs[i], objs[(seed >> 33) % (i + 1)]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                objs[i]->next = objs[(i + 1) % count];
+            }
+
+            auto start = chrono::high_resolution_clock::now();
+            Node* cur = objs[0];
+            for (size_t i = 0; i < count * 4; ++i) {
+                cur = cur->next;
+            }
+            auto end = chrono::high_resolution_clock::now();
+            assert(cur == objs[0]);
+
+            cout << "节点0的线程访问节点" << target << (target == 0 ? "（本地）" : "（远端）") << "的内存: 每次 "
+                 << (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (count * 4)
+                 << " ns" << endl;
+            for (Node* obj : objs) {
+                ConcurrentFree(obj, sizeof(Node));
+            }
+        }
+    });
+    t.join();
+#ifdef NUMA_EMULATE_NODES
+    cout << "（模拟模式下所有节点是同一块物理内存，耗时没有差别）" << endl;
+#endif
+    cout << endl;
+}
+
+int main() {
+    TestTopology();
+    TestLocalPlacement();
+    TestPinnedAndRemoteFree();
+    TestAccessLatency();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+// 定长对象池测试 - Span/ThreadCache元数据不再依赖malloc
+#include "../src/ThreadCache.h"
+#include "../src/ObjectPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+void TestReuse() {
+    cout << "=== 测试1: 对象复用 ===" << endl;
+
+    ObjectPool<Span> pool;
+    Span* s1 = pool.New();
+    Span* s2 = pool.New();
+    assert(s1 != s2);
+    // 新对象已经调用过构造函数
+    assert(s1->_n == 0 && s1->_freeList == nullptr && !s1->_isUse);
+
+    s1->_n = 10;
+    pool.Delete(s1);
+    Span* s3 = pool.New();
+    assert(s3 == s1);        // 优先复用刚还回来的对象
+    assert(s3->_n == 0);     // 复用时重新构造
+    pool.Delete(s2);
+    pool.Delete(s3);
+
+    cout << "对象复用 OK" << endl << endl;
+}
+
+void TestAlignment() {
+    cout << "=== 测试2: 对齐 ===" << endl;
+
+    ObjectPool<ThreadCache> pool;
+    vector<ThreadCache*> tcs;
+    for (int i = 0; i < 100; ++i) {
+        ThreadCache* tc = pool.New();
+        assert(((size_t)tc % alignof(ThreadCache)) == 0);
+        tcs.push_back(tc);
+    }
+    for (ThreadCache* tc : tcs) {
+        pool.Delete(tc);
+    }
+
+    cout << "对齐 OK" << endl << endl;
+}
+
+void TestPerformance() {
+    cout << "=== 测试3: 对象池 vs new/delete ===" << endl;
+
+    const size_t rounds = 100;
+    const size_t count = 10000;
+    vector<Span*> spans(count);
+
+    auto start1 = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < count; ++i) spans[i] = new Span;
+        for (size_t i = 0; i < count; ++i) delete spans[i];
+    }
+    auto end1 = chrono::high_resolution_clock::now();
+
+    ObjectPool<Span> pool;
+    auto start2 = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < count; ++i) spans[i] = pool.New();
+        for (size_t i = 0; i < count; ++i) pool.Delete(spans[i]);
+    }
+    auto end2 = chrono::high_resolution_clock::now();
+
+    cout << "new/delete耗时: " << chrono::duration_cast<chrono::milliseconds>(end1 - start1).count() << " ms" << endl;
+    cout << "ObjectPool耗时: " << chrono::duration_cast<chrono::milliseconds>(end2 - start2).count() << " ms" << endl;
+    cout << endl;
+}
+
+int main() {
+    TestReuse();
+    TestAlignment();
+    TestPerformance();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
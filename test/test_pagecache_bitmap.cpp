@@ -0,0 +1,66 @@
+// PageCache非空链表位图测试 - NewSpan找不少于k页的最小非空链表不再逐个检查128个链表
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// 随机大小的Span反复申请释放，检查页数正确、互不重叠，全部释放后页数回到基线
+void TestCorrectness() {
+    cout << "=== 测试1: 随机申请释放 ===" << endl;
+
+    PageCache* pc = PageCache::GetInstance();
+    size_t baseline = pc->GetUsePages();
+    vector<Span*> spans;
+    size_t seed = 7;
+    for (int round = 0; round < 100000; ++round) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (spans.size() < 64 && (seed >> 40) % 3 != 0) {
+            size_t k = (seed >> 33) % 128 + 1;
+            Span* span = pc->NewSpan(k);
+            assert(span->_n == k && span->_isUse);
+            // 首尾页都映射到这个Span，说明没有和别的Span重叠
+            assert(pc->MapObjectToSpan((void*)(span->_pageId << PAGE_SHIFT)) == span);
+            assert(pc->MapObjectToSpan((void*)((span->_pageId + k - 1) << PAGE_SHIFT)) == span);
+            spans.push_back(span);
+        }
+        else if (!spans.empty()) {
+            size_t i = (seed >> 33) % spans.size();
+            pc->ReleaseSpanToPageCache(spans[i]);
+            spans[i] = spans.back();
+            spans.pop_back();
+        }
+    }
+    for (Span* span : spans) {
+        pc->ReleaseSpanToPageCache(span);
+    }
+    assert(pc->GetUsePages() == baseline);
+    cout << "随机申请释放 OK" << endl << endl;
+}
+
+// 只有大的空闲Span、申请小Span时要跳过大量空链表，这是位图要优化的情况
+void TestSparseLookup() {
+    cout << "=== 测试2: 空链表很多时的NewSpan耗时 ===" << endl;
+
+    PageCache* pc = PageCache::GetInstance();
+    const size_t rounds = 1000000;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        // 申请1页：只有128页的空闲Span，要跳过127个空链表；释放后又合并回128页
+        Span* span = pc->NewSpan(1);
+        pc->ReleaseSpanToPageCache(span);
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << "NewSpan(1)+释放 x " << rounds << "次: 每次 "
+         << (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / rounds
+         << " ns" << endl << endl;
+}
+
+int main() {
+    TestCorrectness();
+    TestSparseLookup();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+// PageCache分片测试 - 多线程反复申请/释放Span时，全局一把锁会成为瓶颈
+// 分别编译单锁和分片两个版本，对比1~64线程的吞吐：
+//   g++ -std=c++17 -O2 -pthread test/test_pagecache_shards.cpp src/CentralCache.cpp src/PageCache.cpp -o single_lock
+//   g++ -std=c++17 -O2 -pthread -DPAGE_CACHE_SHARDS=8 test/test_pagecache_shards.cpp src/CentralCache.cpp src/PageCache.cpp -o sharded
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// 每个线程保留少量存活Span，随机申请/释放（1~8页，CentralCache申请Span的常见大小）
+static void SpanChurn(size_t ops, size_t seed, bool check) {
+    PageCache* pc = PageCache::GetInstance();
+    vector<Span*> live;
+    for (size_t i = 0; i < ops; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (live.size() < 16 && (seed >> 40) % 2 == 0) {
+            size_t k = (seed >> 33) % 8 + 1;
+            Span* span = pc->NewSpan(k);
+            if (check) {
+                assert(span->_n == k && span->_isUse && span->_shard < PAGE_CACHE_SHARDS);
+                assert(pc->MapObjectToSpan((void*)(span->_pageId << PAGE_SHIFT)) == span);
+                assert(pc->MapObjectToSpan((void*)((span->_pageId + k - 1) << PAGE_SHIFT)) == span);
+                // 写首尾页，多个线程拿到重叠的Span会被后面的检查发现
+                *(Span**)(span->_pageId << PAGE_SHIFT) = span;
+            }
+            live.push_back(span);
+        }
+        else if (!live.empty()) {
+            size_t j = (seed >> 33) % live.size();
+            if (check) {
+                assert(*(Span**)(live[j]->_pageId << PAGE_SHIFT) == live[j]);
+            }
+            pc->ReleaseSpanToPageCache(live[j]);
+            live[j] = live.back();
+            live.pop_back();
+        }
+    }
+    for (Span* span : live) {
+        pc->ReleaseSpanToPageCache(span);
+    }
+}
+
+void TestConcurrentCorrectness() {
+    cout << "=== 测试1: 多线程申请释放Span ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    vector<thread> threads;
+    for (size_t i = 0; i < 8; ++i) {
+        threads.emplace_back(SpanChurn, 50000, i + 1, true);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(PageCache::GetInstance()->GetUsePages() == baseline);
+    cout << PAGE_CACHE_SHARDS << "个分片，8线程随机申请释放 OK" << endl << endl;
+}
+
+// 一个线程申请的Span交给别的线程释放，要还回原来的分片
+void TestCrossThreadRelease() {
+    cout << "=== 测试2: 跨线程释放 ===" << endl;
+
+    PageCache* pc = PageCache::GetInstance();
+    size_t baseline = pc->GetUsePages();
+    vector<Span*> spans;
+    for (size_t shard = 0; shard < PAGE_CACHE_SHARDS; ++shard) {
+        for (size_t k = 1; k <= 4; ++k) {
+            Span* span = pc->NewSpan(k, shard);
+            assert(span->_n == k && span->_shard < PAGE_CACHE_SHARDS);
+            spans.push_back(span);
+        }
+    }
+    thread t([&spans]() {
+        for (Span* span : spans) {
+            PageCache::GetInstance()->ReleaseSpanToPageCache(span);
+        }
+    });
+    t.join();
+    assert(pc->GetUsePages() == baseline);
+    cout << "跨线程释放 OK" << endl << endl;
+}
+
+// 1~64线程，每个线程做同样多次申请/释放，看总吞吐
+void TestScaling() {
+    cout << "=== 测试3: 1~64线程吞吐（" << PAGE_CACHE_SHARDS << "个分片） ===" << endl;
+
+    const size_t opsPerThread = 100000;
+    for (size_t threadCount = 1; threadCount <= 64; threadCount *= 2) {
+        auto start = chrono::high_resolution_clock::now();
+        vector<thread> threads;
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back(SpanChurn, opsPerThread, i + 100, false);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        auto end = chrono::high_resolution_clock::now();
+        double ns = (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        cout << threadCount << "线程: " << (long long)(ns / 1000000) << " ms, 每次操作 "
+             << ns / (threadCount * opsPerThread) << " ns, 吞吐 "
+             << (long long)(threadCount * opsPerThread / (ns / 1e9)) << " 次/秒" << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestConcurrentCorrectness();
+    TestCrossThreadRelease();
+    TestScaling();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,98 @@
+// 基数树页表测试 - PageMap替换unordered_map后的正确性验证
+#include "../src/ConcurrentMemoryPool.h"
+#include "../src/PageMap.h"
+#include <vector>
+
+void TestBasicSetGet() {
+    cout << "=== 测试1: Set/Get基本功能 ===" << endl;
+
+    static PageMap pageMap;  // 根节点较大，放静态区
+    Span span1, span2;
+
+    // 没建立映射的页号返回nullptr
+    assert(pageMap.Get(12345) == nullptr);
+
+    pageMap.Set(12345, &span1);
+    pageMap.Set(12346, &span2);
+    assert(pageMap.Get(12345) == &span1);
+    assert(pageMap.Get(12346) == &span2);
+    assert(pageMap.Get(12347) == nullptr);
+
+    // 跨叶子、跨中间节点的页号
+    PAGE_ID farId = ((PAGE_ID)1 << 30) + 7;
+    pageMap.Set(farId, &span1);
+    assert(pageMap.Get(farId) == &span1);
+    assert(pageMap.Get(farId - 1) == nullptr);
+
+    // 批量映射一段跨叶子的页号
+    PAGE_ID rangeId = ((PAGE_ID)1 << 20) - 100;
+    pageMap.SetRange(rangeId, 300, &span2);
+    assert(pageMap.Get(rangeId - 1) == nullptr);
+    for (PAGE_ID id = rangeId; id < rangeId + 300; ++id) {
+        assert(pageMap.Get(id) == &span2);
+    }
+    assert(pageMap.Get(rangeId + 300) == nullptr);
+
+    cout << "Set/Get OK" << endl << endl;
+}
+
+void TestObjectToSpan() {
+    cout << "=== 测试2: 对象地址查找Span ===" << endl;
+
+    size_t sizes[] = {8, 16, 128, 1000, 8 * 1024, 64 * 1024};
+    for (size_t size : sizes) {
+        std::vector<void*> ptrs;
+        for (int i = 0; i < 1000; ++i) {
+            ptrs.push_back(ConcurrentAlloc(size));
+        }
+        for (void* p : ptrs) {
+            Span* span = PageCache::GetInstance()->MapObjectToSpan(p);
+            assert(span != nullptr);
+            assert(span->_objSize == SizeClass::RoundUp(size));
+            assert(span->_isUse);
+        }
+        for (void* p : ptrs) {
+            ConcurrentFree(p, size);
+        }
+        cout << "  " << size << "字节 OK" << endl;
+    }
+    cout << endl;
+}
+
+// 多线程下释放路径无锁查页表
+void ThreadTask(size_t size, int rounds) {
+    std::vector<void*> ptrs;
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < 2000; ++i) {
+            ptrs.push_back(ConcurrentAlloc(size));
+        }
+        for (void* p : ptrs) {
+            ConcurrentFree(p, size);
+        }
+        ptrs.clear();
+    }
+}
+
+void TestMultiThread() {
+    cout << "=== 测试3: 多线程分配释放 ===" << endl;
+
+    std::vector<std::thread> threads;
+    size_t sizes[] = {8, 24, 256, 4096};
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back(ThreadTask, sizes[i % 4], 20);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    cout << "多线程测试完成" << endl << endl;
+}
+
+int main() {
+    TestBasicSetGet();
+    TestObjectToSpan();
+    TestMultiThread();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
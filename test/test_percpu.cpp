@@ -0,0 +1,137 @@
+// per-CPU缓存测试 - 线程数远多于CPU核数时的正确性和内存占用
+// 默认编译走ThreadCache，添加 -DENABLE_PERCPU 走rseq per-CPU缓存，两次结果对比：
+//   g++ -std=c++17 -O2 -pthread -DENABLE_PERCPU test/test_percpu.cpp src/CentralCache.cpp src/PageCache.cpp -o percpu
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+#include <atomic>
+
+using namespace std;
+
+#ifdef PERCPU_RSEQ
+static const char* FRONT_END = "per-CPU缓存";
+#else
+static const char* FRONT_END = "ThreadCache";
+#endif
+
+// 正确性：每个对象写入线程号，释放前检查没有被别人改写（同一个对象被分给两个线程时会出错）
+void CheckTask(size_t id, atomic<size_t>* errors) {
+    size_t sizes[] = {8, 16, 48, 128, 512, 2048, 16 * 1024};
+    vector<pair<size_t*, size_t>> ptrs;
+
+    for (int round = 0; round < 50; ++round) {
+        for (size_t i = 0; i < 300; ++i) {
+            size_t size = sizes[(i + id) % 7];
+            size_t* p = (size_t*)ConcurrentAlloc(size);
+            *p = id;
+            ptrs.push_back({p, size});
+        }
+        for (auto& kv : ptrs) {
+            if (*kv.first != id) {
+                (*errors)++;
+            }
+            ConcurrentFree(kv.first, kv.second);
+        }
+        ptrs.clear();
+    }
+#ifdef PERCPU_RSEQ
+    // per-CPU前端只用本线程的统计，不应该为它创建ThreadCache（不支持rseq退回ThreadCache的除外）
+    if (CurrentRseq() != nullptr) {
+        assert(pTLSThreadCache == nullptr && pTLSThreadStats != nullptr);
+    }
+#endif
+}
+
+void TestCorrectness(size_t threadCount) {
+    cout << "=== 测试1: " << threadCount << "线程正确性 ===" << endl;
+
+    atomic<size_t> errors{0};
+    vector<thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(CheckTask, i, &errors);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    assert(errors.load() == 0);
+    cout << "[" << FRONT_END << "] 正确性 OK" << endl << endl;
+}
+
+// 内存占用：大量线程各自分配释放一批对象后挂起，观察缓存占用的页数
+void TestFootprint(size_t threadCount) {
+    cout << "=== 测试2: " << threadCount << "线程缓存占用 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    atomic<size_t> ready{0};
+    atomic<bool> quit{false};
+
+    vector<thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&]() {
+            vector<void*> ptrs;
+            for (size_t size = 16; size <= 1024; size *= 2) {
+                for (int j = 0; j < 200; ++j) {
+                    ptrs.push_back(ConcurrentAlloc(size));
+                }
+            }
+            for (void* p : ptrs) {
+                ConcurrentFree(p);
+            }
+            ready++;
+            while (!quit.load()) {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        });
+    }
+    while (ready.load() < threadCount) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    size_t used = PageCache::GetInstance()->GetUsePages() - baseline;
+    cout << "[" << FRONT_END << "] 线程空闲时缓存占用: " << used << " 页 ("
+         << (double)(used << PAGE_SHIFT) / 1024 / 1024 << " MB)" << endl << endl;
+
+    quit = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// 吞吐
+void TestThroughput(size_t threadCount, size_t size) {
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([size]() {
+            vector<void*> ptrs(100);
+            for (int r = 0; r < 20000; ++r) {
+                for (auto& p : ptrs) p = ConcurrentAlloc(size);
+                for (auto& p : ptrs) ConcurrentFree(p, size);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << "[" << FRONT_END << "] " << threadCount << "线程 " << size << "字节: "
+         << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+}
+
+int main() {
+    cout << "========== 前端: " << FRONT_END << "，CPU核数: " << thread::hardware_concurrency()
+         << " ==========" << endl << endl;
+
+    TestCorrectness(thread::hardware_concurrency() * 8);
+    TestFootprint(64);
+
+    cout << "=== 测试3: 吞吐 ===" << endl;
+    TestThroughput(1, 16);
+    TestThroughput(8, 16);
+    TestThroughput(8, 256);
+
+    cout << "\n所有测试完成！" << endl;
+    return 0;
+}
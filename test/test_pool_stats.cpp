@@ -0,0 +1,197 @@
+// 分片统计测试 - GetPoolStats / PrintPoolStats
+// 正确性：分配/释放次数和使用中的字节数对得上、退出线程的统计不丢、
+//         每个size class的对象（使用中+前端缓存+传输缓存+CentralCache空闲）正好等于它的Span能切出的对象数
+// 性能：统计一直开着时的分配/释放快路径，和原来每次操作对全局原子变量做读-改-写的方式对比；汇总一次的耗时
+//   g++ -std=c++17 -O2 -pthread test/test_pool_stats.cpp src/CentralCache.cpp src/PageCache.cpp -o pool_stats
+#include "../src/ConcurrentMemoryPool.h"
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+// 所有线程都停下来时，每个size class的对象不多不少分布在各层里
+static void CheckConsistent(const PoolStats& stats) {
+    for (size_t i = 0; i < NFREELIST; ++i) {
+        const SizeClassStats& sc = stats.sizeClasses[i];
+        uint64_t objects = sc.inUseObjects + sc.frontEndObjects + sc.transferObjects + sc.centralFreeObjects;
+        uint64_t perSpan = (SizeClass::ClassPages(i) << PAGE_SHIFT) / sc.size;
+        assert(objects == sc.spanCount * perSpan);
+    }
+    assert(stats.committedBytes == stats.systemBytes - stats.returnedBytes);
+    assert(stats.peakUseBytes >= stats.systemBytes - stats.returnedBytes - stats.pageCacheFreeBytes);
+}
+
+void TestSingleThread() {
+    cout << "=== 测试1: 单线程计数 ===" << endl;
+
+    PoolStats s0 = GetPoolStats();
+    CheckConsistent(s0);
+
+    vector<void*> ptrs;
+    for (int i = 0; i < 1000; ++i) {
+        ptrs.push_back(ConcurrentAlloc(100));
+    }
+    void* big = ConcurrentAlloc(300 * 1024);
+    void* aligned = ConcurrentAlignedAlloc(64, 4096);
+
+    PoolStats s1 = GetPoolStats();
+    CheckConsistent(s1);
+    assert(s1.allocCount - s0.allocCount == 1002);
+    size_t alignedSize = AlignedAllocSize(64, 4096);
+    assert(s1.inUseBytes - s0.inUseBytes == 1000 * SizeClass::RoundUp(100) + SizeClass::RoundUp(300 * 1024) + alignedSize);
+    assert(s1.largeInUseBytes - s0.largeInUseBytes == SizeClass::RoundUp(300 * 1024));
+    size_t index = SizeClass::Index(100);
+    assert(s1.sizeClasses[index].inUseObjects - s0.sizeClasses[index].inUseObjects == 1000);
+
+    // 大内存原地变大/变小，按实际页数计
+    big = ConcurrentRealloc(big, 600 * 1024);
+    PoolStats s2 = GetPoolStats();
+    Span* span = PageCache::GetInstance()->MapObjectToSpan(big);
+    assert(s2.largeInUseBytes - s0.largeInUseBytes == span->_n << PAGE_SHIFT);
+
+    for (void* p : ptrs) {
+        ConcurrentFree(p, 100);
+    }
+    ConcurrentFree(big);
+    ConcurrentAlignedFree(aligned, 64, 4096);
+
+    PoolStats s3 = GetPoolStats();
+    CheckConsistent(s3);
+    assert(s3.freeCount - s0.freeCount == s3.allocCount - s0.allocCount);  // realloc没能原地调整时多一次分配和释放
+    assert(s3.inUseBytes == s0.inUseBytes);
+
+#ifndef PERCPU_RSEQ
+    // 清空缓存后，前端缓存和传输缓存都是空的
+    GetTLSThreadCache()->ReleaseAll();
+    TransferCache::GetInstance()->Flush();
+    PoolStats s4 = GetPoolStats();
+    CheckConsistent(s4);
+    assert(s4.threadCacheBytes == 0 && s4.transferCacheBytes == 0);
+#endif
+
+    PrintPoolStats(s1);
+    cout << endl;
+}
+
+void TestMultiThread() {
+    cout << "=== 测试2: 多线程，线程退出后统计不丢 ===" << endl;
+
+    PoolStats s0 = GetPoolStats();
+    const size_t threadCount = 8;
+    const size_t rounds = 100000;
+    vector<vector<void*>> survivors(threadCount);
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([t, &survivors]() {
+            size_t sizes[] = {8, 48, 200, 1500, 9000};
+            for (size_t r = 0; r < rounds; ++r) {
+                size_t size = sizes[(r + t) % 5];
+                void* p = ConcurrentAlloc(size);
+                if (r % 100 == 0) {
+                    survivors[t].push_back(p);  // 留给主线程释放
+                }
+                else {
+                    ConcurrentFree(p, size);
+                }
+            }
+        });
+    }
+
+    // 运行中也能随时汇总
+    uint64_t last = 0;
+    for (int i = 0; i < 20; ++i) {
+        PoolStats s = GetPoolStats();
+        assert(s.allocCount >= last);
+        last = s.allocCount;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    PoolStats s1 = GetPoolStats();
+    CheckConsistent(s1);
+    assert(s1.allocCount - s0.allocCount == threadCount * rounds);
+    assert(s1.inUseBytes - s0.inUseBytes > 0);
+
+    // 别的线程分配的对象由主线程释放
+    for (auto& v : survivors) {
+        for (void* p : v) {
+            ConcurrentFree(p);
+        }
+    }
+    PoolStats s2 = GetPoolStats();
+    CheckConsistent(s2);
+    assert(s2.freeCount - s0.freeCount == threadCount * rounds);
+    assert(s2.inUseBytes == s0.inUseBytes);
+    cout << threadCount << "个线程 x " << rounds << "次 OK" << endl << endl;
+}
+
+// 原来开启ENABLE_STATS时每次分配/释放对共享原子变量做的读-改-写
+std::atomic<size_t> g_oldAllocCount{0};
+std::atomic<size_t> g_oldFreeCount{0};
+std::atomic<size_t> g_oldCurrentMemory{0};
+std::atomic<size_t> g_oldPeakMemory{0};
+
+// threadCount个线程各做rounds对分配+释放，返回ns/对
+static double Benchmark(size_t threadCount, bool oldStats) {
+    const size_t rounds = 2000000;
+    const size_t size = 16;
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([oldStats]() {
+            for (size_t r = 0; r < rounds; ++r) {
+                if (oldStats) {
+                    g_oldAllocCount++;
+                    g_oldCurrentMemory += size;
+                    size_t current = g_oldCurrentMemory.load();
+                    if (current > g_oldPeakMemory.load()) {
+                        g_oldPeakMemory.store(current);
+                    }
+                }
+                void* p = ConcurrentAlloc(size);
+                if (oldStats) {
+                    g_oldFreeCount++;
+                    g_oldCurrentMemory -= size;
+                }
+                ConcurrentFree(p, size);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / rounds;
+}
+
+void TestPerformance() {
+    cout << "=== 测试3: 统计的开销（16字节分配+释放，每线程ns/对） ===" << endl;
+
+    for (size_t threadCount : {1, 4, 8}) {
+        double sharded = Benchmark(threadCount, false);
+        double atomics = Benchmark(threadCount, true);
+        cout << "  " << threadCount << "线程: 分线程计数 " << sharded << " ns, 再加上全局原子计数 " << atomics << " ns"
+             << endl;
+    }
+
+    const size_t n = 1000;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        PoolStats s = GetPoolStats();
+        (void)s;
+    }
+    auto end = chrono::high_resolution_clock::now();
+    cout << "  GetPoolStats: " << (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / n / 1000
+         << " us/次" << endl << endl;
+}
+
+int main() {
+    TestSingleThread();
+    TestMultiThread();
+    TestPerformance();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
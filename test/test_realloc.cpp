@@ -0,0 +1,215 @@
+// 重新分配测试 - ConcurrentRealloc（带size和不带size）
+// 正确性：同一个size class原地返回，大内存原地扩大/缩小，数据不丢，页数不泄漏
+// 性能：模拟std::vector的增长方式（2倍、1.5倍、每次加一点），对比申请+拷贝+释放和glibc realloc
+//   g++ -std=c++17 -O2 -pthread test/test_realloc.cpp src/CentralCache.cpp src/PageCache.cpp -o realloc
+#include "../src/ConcurrentMemoryPool.h"
+#include "TestUtil.h"
+#include <chrono>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+
+// 往[p+from, p+to)写按偏移生成的数据，Check检查[p, p+size)全是这样的数据
+// 不内联：内联后GCC顺着分配路径推断对象大小，会误报-Wstringop-overflow
+__attribute__((noinline)) static void Fill(void* p, size_t from, size_t to) {
+    unsigned char* bytes = (unsigned char*)p;
+    for (size_t i = from; i < to; ++i) {
+        bytes[i] = (unsigned char)(i * 31);
+    }
+}
+__attribute__((noinline)) static void Check(const void* p, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)p;
+    for (size_t i = 0; i < size; ++i) {
+        assert(bytes[i] == (unsigned char)(i * 31));
+    }
+}
+
+void TestSmallInPlace() {
+    cout << "=== 测试1: 小内存同一size class原地返回 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    // 200和205都对齐到208，原地返回；变成300换size class，要拷贝
+    void* p = ConcurrentAlloc(200);
+    Fill(p, 0, 200);
+    void* q = ConcurrentRealloc(p, 200, 205);
+    assert(q == p);
+    Fill(q, 200, 205);
+    void* r = ConcurrentRealloc(q, 205, 300);
+    assert(r != q);
+    Check(r, 205);
+    ConcurrentFree(r, 300);
+
+    // 不带size：放得下并且用得上一半以上就原地返回，缩得太小换小的size class
+    p = ConcurrentAlloc(1000);
+    Fill(p, 0, 1000);
+    assert(ConcurrentRealloc(p, 1008) == p);
+    assert(ConcurrentRealloc(p, 600) == p);
+    q = ConcurrentRealloc(p, 100);
+    assert(q != p);
+    Check(q, 100);
+    r = ConcurrentRealloc(q, 5000);
+    Check(r, 100);
+    ConcurrentFree(r);
+
+    // nullptr相当于分配，0相当于释放
+    p = ConcurrentRealloc(nullptr, 0, 64);
+    assert(p != nullptr);
+    assert(ConcurrentRealloc(p, 64, 0) == nullptr);
+
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+void TestLargeInPlace() {
+    cout << "=== 测试2: 大内存原地扩大/缩小 ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    // 先分配再释放一大块，保证后面紧挨着有空闲页
+    void* hole = ConcurrentAlloc(8 * 1024 * 1024);
+    ConcurrentFree(hole);
+
+    size_t size = 300 * 1024;
+    void* p = ConcurrentAlloc(size);
+    Fill(p, 0, size);
+    size_t inPlace = 0, moves = 0;
+    while (size < 6 * 1024 * 1024) {
+        size_t newSize = size * 3 / 2;
+        void* q = ConcurrentRealloc(p, size, newSize);
+        (q == p ? inPlace : moves)++;
+        Check(q, size);
+        Fill(q, size, newSize);
+        p = q;
+        size = newSize;
+    }
+    assert(inPlace > 0);
+    cout << "扩大: 原地 " << inPlace << " 次, 拷贝 " << moves << " 次" << endl;
+
+    // 缩小一定原地，尾部还回PageCache
+    size_t usedBefore = PageCache::GetInstance()->GetUsePages();
+    void* q = ConcurrentRealloc(p, size, 512 * 1024);
+    assert(q == p);
+    Check(q, 512 * 1024);
+    assert(PageCache::GetInstance()->GetUsePages() < usedBefore);
+    cout << "缩小到512KB: 原地，还回 " << usedBefore - PageCache::GetInstance()->GetUsePages() << " 页" << endl;
+
+    // 缩到小内存要换成size class里的对象
+    void* r = ConcurrentRealloc(q, 512 * 1024, 1000);
+    assert(r != q);
+    Check(r, 1000);
+    ConcurrentFree(r, 1000);
+
+    // 大对齐的内部地址也能原地调整
+    void* a = ConcurrentAlignedAlloc(400 * 1024, 64 * 1024);
+    Fill(a, 0, 400 * 1024);
+    void* b = ConcurrentRealloc(a, 450 * 1024);
+    Check(b, 400 * 1024);
+    ConcurrentFree(b);
+
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+// 多线程各自反复增长/缩小，同时在页缓存里抢相邻的空闲页
+void TestConcurrent() {
+    cout << "=== 测试3: 多线程realloc ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    vector<thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (size_t round = 0; round < 50; ++round) {
+                size_t size = 8 + t;
+                void* p = ConcurrentRealloc(nullptr, size);
+                Fill(p, 0, size);
+                while (size < 2 * 1024 * 1024) {
+                    size_t newSize = size * 2 + round;
+                    p = ConcurrentRealloc(p, newSize);
+                    Check(p, size);
+                    Fill(p, size, newSize);
+                    size = newSize;
+                }
+                p = ConcurrentRealloc(p, 100);
+                Check(p, 100);
+                ConcurrentFree(p);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    CheckBaseline(baseline);
+    cout << "OK" << endl << endl;
+}
+
+// 按growth的方式从16字节长到maxSize，返回每次增长的平均纳秒数
+template <class Grow, class Release>
+double BenchmarkGrowth(size_t maxSize, size_t (*next)(size_t), Grow grow, Release release) {
+    const size_t rounds = 200;
+    size_t steps = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        size_t size = 16;
+        void* p = grow(nullptr, 0, size);
+        while (size < maxSize) {
+            size_t newSize = next(size);
+            p = grow(p, size, newSize);
+            ((char*)p)[newSize - 1] = 1;  // 模拟写入新增的元素
+            size = newSize;
+            ++steps;
+        }
+        release(p, size);
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / steps;
+}
+
+static size_t GrowDouble(size_t size) { return size * 2; }
+static size_t GrowHalf(size_t size) { return size + size / 2; }
+static size_t GrowStep(size_t size) { return size + 64; }
+
+void TestPerformance() {
+    cout << "=== 测试4: vector式增长（ns/次增长） ===" << endl;
+
+    struct Case {
+        const char* name;
+        size_t (*next)(size_t);
+        size_t maxSize;
+    } cases[] = {
+        {"2倍增长到4MB", GrowDouble, 4 * 1024 * 1024},
+        {"1.5倍增长到4MB", GrowHalf, 4 * 1024 * 1024},
+        {"每次加64字节到64KB", GrowStep, 64 * 1024},
+    };
+
+    for (auto& c : cases) {
+        double pool = BenchmarkGrowth(c.maxSize, c.next,
+            [](void* p, size_t oldSize, size_t newSize) { return ConcurrentRealloc(p, oldSize, newSize); },
+            [](void* p, size_t size) { ConcurrentFree(p, size); });
+        double copy = BenchmarkGrowth(c.maxSize, c.next,
+            [](void* p, size_t oldSize, size_t newSize) {
+                void* q = ConcurrentAlloc(newSize);
+                if (p != nullptr) {
+                    memcpy(q, p, oldSize);
+                    ConcurrentFree(p, oldSize);
+                }
+                return q;
+            },
+            [](void* p, size_t size) { ConcurrentFree(p, size); });
+        double sys = BenchmarkGrowth(c.maxSize, c.next,
+            [](void* p, size_t, size_t newSize) { return realloc(p, newSize); },
+            [](void* p, size_t) { free(p); });
+        cout << "  " << c.name << ": ConcurrentRealloc " << pool << " ns, 申请+拷贝+释放 " << copy
+             << " ns, glibc realloc " << sys << " ns" << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestSmallInPlace();
+    TestLargeInPlace();
+    TestConcurrent();
+    TestPerformance();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,142 @@
+// 内存回收测试 - 空闲Span的物理内存还给系统，流量高峰过后RSS能降下来
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// 从/proc/self/statm读常驻内存（MB）
+static double ResidentMB() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    size_t total = 0, resident = 0;
+    if (f != nullptr) {
+        if (fscanf(f, "%zu %zu", &total, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return (double)resident * sysconf(_SC_PAGESIZE) / 1024 / 1024;
+}
+
+static void PrintMemory(const char* stage) {
+    PageCache* pc = PageCache::GetInstance();
+    size_t system = pc->GetSystemPages();
+    size_t returned = pc->GetReturnedPages();
+    cout << stage << ": 已提交 " << ((system - returned) << PAGE_SHIFT) / 1024 / 1024 << " MB, 已还回 "
+         << (returned << PAGE_SHIFT) / 1024 / 1024 << " MB, 使用中 "
+         << (pc->GetUsePages() << PAGE_SHIFT) / 1024 / 1024 << " MB, RSS " << ResidentMB() << " MB" << endl;
+}
+
+// 模拟一次流量高峰：申请一批大块内存并写满，然后全部释放
+static void TrafficSpike(size_t blockSize, size_t count) {
+    vector<void*> ptrs;
+    for (size_t i = 0; i < count; ++i) {
+        void* p = ConcurrentAlloc(blockSize);
+        memset(p, 0x5a, blockSize);
+        ptrs.push_back(p);
+    }
+    for (void* p : ptrs) {
+        ConcurrentFree(p, blockSize);
+    }
+}
+
+void TestReleaseFreeMemory() {
+    cout << "=== 测试1: ReleaseFreeMemory ===" << endl;
+
+    TrafficSpike(1024 * 1024, 64);
+    PrintMemory("高峰过后");
+    double rssPeak = ResidentMB();
+
+    // 只还一部分
+    size_t released = PageCache::GetInstance()->ReleaseFreeMemory(8 * 1024 * 1024);
+    assert(released >= 8 * 1024 * 1024);
+    PrintMemory("还回8MB后");
+
+    // 全部还回
+    released += PageCache::GetInstance()->ReleaseFreeMemory();
+    PrintMemory("全部还回后");
+    assert(released >= 64 * 1024 * 1024);
+    assert(PageCache::GetInstance()->GetReturnedPages() << PAGE_SHIFT >= 64 * 1024 * 1024);
+#ifndef USE_MADV_FREE
+    // MADV_DONTNEED立刻释放物理页
+    assert(ResidentMB() < rssPeak - 32);
+#else
+    (void)rssPeak;
+#endif
+
+    // 再次使用已还回的内存：按需重新缺页，内容可写
+    size_t returnedBefore = PageCache::GetInstance()->GetReturnedPages();
+    vector<char*> ptrs;
+    for (int i = 0; i < 16; ++i) {
+        char* p = (char*)ConcurrentAlloc(1024 * 1024);
+        memset(p, i, 1024 * 1024);
+        assert(p[0] == i && p[1024 * 1024 - 1] == i);
+        ptrs.push_back(p);
+    }
+    assert(PageCache::GetInstance()->GetReturnedPages() < returnedBefore);
+    PrintMemory("重新使用16MB后");
+    for (char* p : ptrs) {
+        ConcurrentFree(p, 1024 * 1024);
+    }
+    cout << "ReleaseFreeMemory OK" << endl << endl;
+}
+
+void TestScavenger() {
+    cout << "=== 测试2: 后台回收线程 ===" << endl;
+
+    // 每50ms检查一次，空闲超过200ms的还给系统
+    PageCache::GetInstance()->StartScavenger(50, 200, 64 * 1024 * 1024);
+
+    // 块大小不能超过直接mmap的阈值，否则释放时直接还给系统，不经过后台回收
+    const size_t blockSize = min((size_t)2 * 1024 * 1024, (size_t)DIRECT_MMAP_PAGES << PAGE_SHIFT);
+    TrafficSpike(blockSize, 32);
+    size_t returned0 = PageCache::GetInstance()->GetReturnedPages();
+    PrintMemory("高峰过后");
+
+    // 空闲时间还不够，不应该马上回收
+    this_thread::sleep_for(chrono::milliseconds(60));
+    size_t returned1 = PageCache::GetInstance()->GetReturnedPages();
+    assert(returned1 - returned0 < (32 * blockSize >> PAGE_SHIFT));
+
+    this_thread::sleep_for(chrono::milliseconds(600));
+    size_t returned2 = PageCache::GetInstance()->GetReturnedPages();
+    PrintMemory("空闲600ms后");
+    assert((returned2 - returned0) << PAGE_SHIFT >= 32 * blockSize);
+
+    PageCache::GetInstance()->StopScavenger();
+    cout << "后台回收 OK" << endl << endl;
+}
+
+// 已还回的Span和刚释放的Span交错时，分配和合并都要正确
+void TestMixedReuse() {
+    cout << "=== 测试3: 已还回和未还回的Span交错使用 ===" << endl;
+
+    for (int round = 0; round < 20; ++round) {
+        vector<pair<void*, size_t>> ptrs;
+        for (int i = 0; i < 200; ++i) {
+            size_t size = (i % 3 == 0) ? 300 * 1024 : (i % 3 == 1) ? 64 * 1024 : 3 * 1024 * 1024;
+            void* p = ConcurrentAlloc(size);
+            memset(p, round, size);
+            ptrs.push_back({p, size});
+        }
+        for (size_t i = 0; i < ptrs.size(); i += 2) {
+            ConcurrentFree(ptrs[i].first, ptrs[i].second);
+        }
+        PageCache::GetInstance()->ReleaseFreeMemory(16 * 1024 * 1024);
+        for (size_t i = 1; i < ptrs.size(); i += 2) {
+            assert(*(char*)ptrs[i].first == (char)round);
+            ConcurrentFree(ptrs[i].first, ptrs[i].second);
+        }
+    }
+    PrintMemory("交错使用后");
+    cout << "交错使用 OK" << endl << endl;
+}
+
+int main() {
+    TestReleaseFreeMemory();
+    TestScavenger();
+    TestMixedReuse();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
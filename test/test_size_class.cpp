@@ -0,0 +1,121 @@
+// size class查找表测试 - SizeClass::Index/RoundUp/Size/BatchSize/ClassPages
+// 正确性：1~MAX_BYTES每个大小查表结果和原来的分段计算完全一致
+// 性能：分段计算 vs 查表（随机大小，分支预测失败的情况），以及ThreadCache命中时的分配/释放快路径
+//   g++ -std=c++17 -O2 -pthread test/test_size_class.cpp src/CentralCache.cpp src/PageCache.cpp -o size_class
+#include "../src/ConcurrentMemoryPool.h"
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+// 编译期就能查表
+static_assert(SizeClass::Index(8) == 0, "");
+static_assert(SizeClass::Index(129) == 16, "");
+static_assert(SizeClass::RoundUp(1025) == 1152, "");
+static_assert(SizeClass::Size(NFREELIST - 1) == MAX_BYTES, "");
+
+void TestTable() {
+    cout << "=== 测试1: 查表和分段计算一致 ===" << endl;
+
+    for (size_t bytes = 1; bytes <= MAX_BYTES; ++bytes) {
+        size_t index = SizeClass::Index(bytes);
+        size_t size = SizeClass::RoundUp(bytes);
+        assert(index == SizeClass::CalcIndex(bytes));
+        assert(size == SizeClass::CalcRoundUp(bytes));
+        assert(SizeClass::Size(index) == size);
+        assert(SizeClass::BatchSize(index) == SizeClass::NumMoveSize(size));
+        assert(SizeClass::ClassPages(index) == SizeClass::NumMovePage(size));
+    }
+    // 0字节和1~8字节同一个size class
+    assert(SizeClass::Index(0) == 0);
+    assert(SizeClass::RoundUp(0) == 8);
+    // 超过MAX_BYTES按页对齐
+    assert(SizeClass::RoundUp(MAX_BYTES + 1) == MAX_BYTES + (1 << PAGE_SHIFT));
+
+    // 反查覆盖所有size class，且对象大小严格递增
+    for (size_t i = 1; i < NFREELIST; ++i) {
+        assert(SizeClass::Size(i) > SizeClass::Size(i - 1));
+        assert(SizeClass::Index(SizeClass::Size(i)) == i);
+    }
+    cout << "1~" << MAX_BYTES << "字节、" << NFREELIST << "个size class OK" << endl << endl;
+}
+
+// 对sizes里的每个大小算索引和对齐大小，返回ns/次
+template <class F>
+double BenchmarkLookup(const vector<size_t>& sizes, F f) {
+    const size_t rounds = 200;
+    size_t sink = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t bytes : sizes) {
+            sink += f(bytes);
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+    volatile size_t keep = sink;
+    (void)keep;
+    return (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (rounds * sizes.size());
+}
+
+void TestLookupPerformance() {
+    cout << "=== 测试2: 分段计算 vs 查表（ns/次） ===" << endl;
+
+    // 小对象居多、偶尔有大对象，和实际分配的分布差不多
+    vector<size_t> sizes(1 << 16);
+    size_t seed = 12345;
+    for (auto& bytes : sizes) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t r = seed >> 33;
+        bytes = (r % 4 == 0) ? 1 + r % MAX_BYTES : 1 + r % 1024;
+    }
+
+    double calc = BenchmarkLookup(sizes, [](size_t bytes) {
+        return SizeClass::CalcIndex(bytes) + SizeClass::CalcRoundUp(bytes);
+    });
+    double table = BenchmarkLookup(sizes, [](size_t bytes) {
+        return SizeClass::Index(bytes) + SizeClass::RoundUp(bytes);
+    });
+    cout << "  Index+RoundUp: 分段计算 " << calc << " ns, 查表 " << table << " ns" << endl << endl;
+}
+
+// ThreadCache命中时的分配+释放，返回ns/对
+void TestFastPath() {
+    cout << "=== 测试3: 分配/释放快路径（ns/对） ===" << endl;
+
+    size_t cases[] = {16, 200, 3000, 100 * 1024};
+    for (size_t size : cases) {
+        const size_t count = 64;
+        const size_t rounds = 100000;
+        void* ptrs[count];
+        for (size_t i = 0; i < count; ++i) {  // 预热，让FreeList里缓存足够的对象
+            ptrs[i] = ConcurrentAlloc(size);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            ConcurrentFree(ptrs[i], size);
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t i = 0; i < count; ++i) {
+                ptrs[i] = ConcurrentAlloc(size);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                ConcurrentFree(ptrs[i], size);
+            }
+        }
+        auto end = chrono::high_resolution_clock::now();
+        cout << "  " << size << "字节: "
+             << (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (rounds * count) << " ns"
+             << endl;
+    }
+    cout << endl;
+}
+
+int main() {
+    TestTable();
+    TestLookupPerformance();
+    TestFastPath();
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
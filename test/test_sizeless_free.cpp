@@ -0,0 +1,85 @@
+// 不带size的释放接口测试 - ConcurrentFree(void*)
+// 正确性：大小对象都能通过页表找到Span正确释放
+// 性能：对比带size和不带size的释放耗时（ns/次）
+#include "../src/ConcurrentMemoryPool.h"
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+void TestSizelessFree() {
+    cout << "=== 测试1: 不带size释放 ===" << endl;
+
+    size_t sizes[] = {1, 8, 100, 1024, 8 * 1024, 256 * 1024, 256 * 1024 + 1, 1024 * 1024, 2 * 1024 * 1024};
+    for (size_t size : sizes) {
+        void* p = ConcurrentAlloc(size);
+        Span* span = PageCache::GetInstance()->MapObjectToSpan(p);
+        assert(span != nullptr);
+        assert(span->_objSize >= size);
+        // 大内存通过_objSize > MAX_BYTES区分
+        assert((span->_objSize > MAX_BYTES) == (size > MAX_BYTES));
+        ConcurrentFree(p);
+        cout << "  " << size << "字节 OK" << endl;
+    }
+
+    // 同一块内存反复申请释放，验证释放确实回到了池里
+    void* p1 = ConcurrentAlloc(64);
+    ConcurrentFree(p1);
+    void* p2 = ConcurrentAlloc(64);
+    assert(p1 == p2);
+    ConcurrentFree(p2);
+
+    cout << endl;
+}
+
+// 只统计释放阶段的耗时，返回平均每次释放的纳秒数
+double BenchmarkFree(size_t size, size_t count, size_t rounds, bool sizeless) {
+    vector<void*> ptrs(count);
+    long long totalNs = 0;
+
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < count; i++) {
+            ptrs[i] = ConcurrentAlloc(size);
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        if (sizeless) {
+            for (size_t i = 0; i < count; i++) {
+                ConcurrentFree(ptrs[i]);
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                ConcurrentFree(ptrs[i], size);
+            }
+        }
+        auto end = chrono::high_resolution_clock::now();
+        totalNs += chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    }
+
+    return (double)totalNs / (count * rounds);
+}
+
+void CompareFree(size_t size) {
+    // 先预热一轮，让ThreadCache里有缓存
+    BenchmarkFree(size, 1000, 1, false);
+
+    double sizedNs = BenchmarkFree(size, 1000, 1000, false);
+    double sizelessNs = BenchmarkFree(size, 1000, 1000, true);
+
+    cout << "对象大小 " << size << " 字节：" << endl;
+    cout << "  ConcurrentFree(ptr, size): " << sizedNs << " ns/次" << endl;
+    cout << "  ConcurrentFree(ptr):       " << sizelessNs << " ns/次" << endl;
+    cout << "  差值: " << sizelessNs - sizedNs << " ns" << endl;
+}
+
+int main() {
+    TestSizelessFree();
+
+    cout << "=== 测试2: 释放性能对比 ===" << endl;
+    CompareFree(16);
+    CompareFree(128);
+    CompareFree(1024);
+
+    cout << "\n所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+// CentralCache Span链表测试 - 大量存活对象（大量满Span）时取对象不能再线性扫描
+// 旧实现每次取对象都从头扫描SpanList找有空闲对象的Span，满Span越多越慢（整体接近O(n^2)）；
+// 按占用率分桶后只看非空桶，耗时应该和存活对象数量成正比。
+// 开启ENABLE_LOCK_PROFILE可以同时看到CentralCache桶锁的持有时间：
+//   g++ -std=c++17 -O2 -pthread -DENABLE_LOCK_PROFILE test/test_span_lists.cpp src/CentralCache.cpp src/PageCache.cpp -o span_lists
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+#ifdef ENABLE_LOCK_PROFILE
+// 所有CentralCache桶锁的累计持有时间（纳秒）
+static uint64_t CentralLockHoldNs() {
+    LockProfile profile = GetLockProfile();
+    uint64_t ns = 0;
+    for (const LockStats& s : profile.central) {
+        ns += s.holdNs;
+    }
+    return ns;
+}
+#endif
+
+// 场景1：持续增长的存活堆，每个对象都不释放
+void TestGrowingHeap(size_t size, size_t count) {
+#ifdef ENABLE_LOCK_PROFILE
+    uint64_t ns0 = CentralLockHoldNs();
+#endif
+    vector<void*> ptrs(count);
+
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        ptrs[i] = ConcurrentAlloc(size);
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    long long ms = chrono::duration_cast<chrono::milliseconds>(end - start).count();
+    cout << size << "字节 x " << count << "个存活对象: " << ms << " ms, 每个对象 "
+         << (double)chrono::duration_cast<chrono::nanoseconds>(end - start).count() / count << " ns";
+#ifdef ENABLE_LOCK_PROFILE
+    cout << ", CentralCache锁持有 " << (CentralLockHoldNs() - ns0) / 1000 << " us";
+#endif
+    cout << endl;
+
+    for (void* p : ptrs) {
+        ConcurrentFree(p, size);
+    }
+}
+
+// 场景2：大存活堆上做随机释放/再分配，被释放的对象散落在大量Span里
+// 检查对象不会重复分配，同时观察耗时
+void TestChurnOnLargeHeap(size_t size, size_t count, size_t rounds) {
+    vector<void*> ptrs(count);
+    for (size_t i = 0; i < count; ++i) {
+        ptrs[i] = ConcurrentAlloc(size);
+        *(size_t*)ptrs[i] = i;
+    }
+
+    size_t seed = 12345;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        // 随机释放1/4再分配回来
+        vector<size_t> picked;
+        for (size_t i = 0; i < count / 4; ++i) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t k = (seed >> 33) % count;
+            if (ptrs[k] != nullptr) {
+                assert(*(size_t*)ptrs[k] == k);
+                ConcurrentFree(ptrs[k], size);
+                ptrs[k] = nullptr;
+                picked.push_back(k);
+            }
+        }
+        for (size_t k : picked) {
+            ptrs[k] = ConcurrentAlloc(size);
+            *(size_t*)ptrs[k] = k;
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < count; ++i) {
+        assert(*(size_t*)ptrs[i] == i);
+        ConcurrentFree(ptrs[i], size);
+    }
+    cout << size << "字节 " << count << "个存活对象上随机释放/分配 " << rounds << "轮: "
+         << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+}
+
+int main() {
+    cout << "=== 场景1: 存活堆增长（满Span越来越多） ===" << endl;
+    TestGrowingHeap(1024, 100000);
+    TestGrowingHeap(1024, 200000);
+    TestGrowingHeap(1024, 400000);
+    TestGrowingHeap(16, 2000000);
+    cout << endl;
+
+    cout << "=== 场景2: 大存活堆上随机释放/分配 ===" << endl;
+    TestChurnOnLargeHeap(256, 400000, 5);
+    cout << endl;
+
+    // 全部释放后Span都应该还给PageCache
+    TransferCache::GetInstance()->Flush();
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
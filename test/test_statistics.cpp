@@ -6,22 +6,27 @@ using namespace std;
 
 // ========== 辅助函数 ==========
 
-// 打印统计数据
+// 统计是累计值，"重置"就是记下当前值，之后打印和它的差
+static PoolStats g_baseline;
+
+// 打印统计数据（currentMemory按size class/页对齐后的大小计，peakMemory是PageCache按页计的峰值）
 void PrintStats() {
+    PoolStats stats = GetPoolStats();
     cout << "========== 统计数据 ==========" << endl;
-    cout << "allocCount:    " << g_allocCount.load() << endl;
-    cout << "freeCount:     " << g_freeCount.load() << endl;
-    cout << "currentMemory: " << g_currentMemory.load() << " 字节" << endl;
-    cout << "peakMemory:    " << g_peakMemory.load() << " 字节" << endl;
+    cout << "allocCount:    " << stats.allocCount - g_baseline.allocCount << endl;
+    cout << "freeCount:     " << stats.freeCount - g_baseline.freeCount << endl;
+    cout << "currentMemory: " << stats.inUseBytes - g_baseline.inUseBytes << " 字节" << endl;
+    cout << "peakMemory:    " << stats.peakUseBytes << " 字节" << endl;
     cout << "==============================" << endl;
 }
 
 // 重置统计数据
 void ResetStats() {
-    g_allocCount.store(0);
-    g_freeCount.store(0);
-    g_currentMemory.store(0);
-    g_peakMemory.store(0);
+    g_baseline = GetPoolStats();
+}
+
+static size_t CurrentMemory() {
+    return GetPoolStats().inUseBytes - g_baseline.inUseBytes;
 }
 
 // ========== 测试用例 ==========
@@ -84,20 +89,20 @@ void TestPeakMemory() {
     
     // 先分配1KB
     void* p1 = ConcurrentAlloc(1024);
-    cout << "分配 1KB 后，currentMemory = " << g_currentMemory.load() << " 字节" << endl;
+    cout << "分配 1KB 后，currentMemory = " << CurrentMemory() << " 字节" << endl;
     
     // 再分配2KB
     void* p2 = ConcurrentAlloc(2048);
-    cout << "再分配 2KB 后，currentMemory = " << g_currentMemory.load() << " 字节" << endl;
-    cout << "此时峰值 peakMemory = " << g_peakMemory.load() << " 字节（应该是3072=1024+2048）" << endl;
+    cout << "再分配 2KB 后，currentMemory = " << CurrentMemory() << " 字节" << endl;
+    cout << "此时峰值 peakMemory = " << GetPoolStats().peakUseBytes << " 字节（按页计，至少是当前占用的页）" << endl;
     
     // 释放第一个1KB
     ConcurrentFree(p1, 1024);
-    cout << "\n释放 1KB 后，currentMemory = " << g_currentMemory.load() << " 字节" << endl;
+    cout << "\n释放 1KB 后，currentMemory = " << CurrentMemory() << " 字节" << endl;
     
     // 查看峰值（峰值不应该变小）
-    cout << "峰值内存 peakMemory = " << g_peakMemory.load() << " 字节" << endl;
-    cout << "分析：峰值应该保持 3072 字节，不会因为释放而减少" << endl;
+    cout << "峰值内存 peakMemory = " << GetPoolStats().peakUseBytes << " 字节" << endl;
+    cout << "分析：峰值不会因为释放而减少" << endl;
     
     // 释放第二个2KB
     ConcurrentFree(p2, 2048);
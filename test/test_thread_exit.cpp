@@ -0,0 +1,65 @@
+// 线程退出回收测试 - 大量短命线程退出后，ThreadCache里缓存的对象要全部还回去
+// 验证方法：所有线程结束后，PageCache分配出去的页数回到基线
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+
+using namespace std;
+
+// 短命线程：分配一批不同大小的对象，全部释放（此时对象还缓存在ThreadCache里），然后退出
+void ShortLivedTask(size_t id) {
+    size_t sizes[] = {8, 16, 32, 64, 128, 256, 1024, 4096, 16 * 1024};
+    vector<pair<void*, size_t>> ptrs;
+
+    for (size_t i = 0; i < 200; ++i) {
+        size_t size = sizes[(i + id) % 9];
+        void* p = ConcurrentAlloc(size);
+        *(char*)p = (char)id;
+        ptrs.push_back({p, size});
+    }
+    for (auto& kv : ptrs) {
+        ConcurrentFree(kv.first, kv.second);
+    }
+}
+
+void TestThreadExit(size_t threadCount, size_t batch) {
+    cout << "=== " << threadCount << "个短命线程（每批" << batch << "个并发） ===" << endl;
+
+    size_t baseline = PageCache::GetInstance()->GetUsePages();
+    cout << "基线页数: " << baseline << endl;
+
+    for (size_t done = 0; done < threadCount; done += batch) {
+        vector<thread> threads;
+        for (size_t i = 0; i < batch; ++i) {
+            threads.emplace_back(ShortLivedTask, done + i);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    // 线程归还的整批对象可能还在传输缓存里（留给别的线程用），先全部还回Span
+    TransferCache::GetInstance()->Flush();
+    size_t after = PageCache::GetInstance()->GetUsePages();
+    cout << "全部退出后页数: " << after << endl;
+
+#ifdef PERCPU_RSEQ
+    // per-CPU缓存不属于任何线程，线程退出时不归还，这里只打印不检查
+    cout << "per-CPU前端：缓存按CPU保留，不检查基线" << endl << endl;
+#else
+    // 线程退出时缓存全部归还，Span对象全部空闲，页数必须回到基线
+    assert(after == baseline);
+    cout << "回到基线 OK" << endl << endl;
+#endif
+}
+
+int main() {
+    // 主线程先用一下，让主线程自己的缓存计入基线
+    void* p = ConcurrentAlloc(16);
+    ConcurrentFree(p, 16);
+
+    TestThreadExit(1000, 1);
+    TestThreadExit(5000, 16);
+
+    cout << "所有测试完成！" << endl;
+    return 0;
+}
@@ -0,0 +1,139 @@
+// 传输缓存测试 - 生产者/消费者模型（一个线程分配，另一个线程释放）
+// 对象总是从消费者的ThreadCache整批还回去，再被生产者整批取走，正好是传输缓存要优化的场景
+// 开启ENABLE_LOCK_PROFILE统计锁持有时间，分别编译有/无传输缓存两个版本对比：
+//   g++ -std=c++17 -O2 -pthread -DENABLE_LOCK_PROFILE test/test_transfer_cache.cpp src/CentralCache.cpp src/PageCache.cpp -o transfer
+//   g++ -std=c++17 -O2 -pthread -DENABLE_LOCK_PROFILE -DDISABLE_TRANSFER_CACHE test/test_transfer_cache.cpp src/CentralCache.cpp src/PageCache.cpp -o no_transfer
+#include "../src/ConcurrentMemoryPool.h"
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <condition_variable>
+
+using namespace std;
+
+#ifdef DISABLE_TRANSFER_CACHE
+static const char* MODE_NAME = "无传输缓存";
+#else
+static const char* MODE_NAME = "传输缓存";
+#endif
+
+// 生产者和消费者之间的队列，一次传一批指针
+class BatchQueue {
+public:
+    void Push(vector<void*>&& batch) {
+        unique_lock<mutex> lock(_mtx);
+        _notFull.wait(lock, [this]() { return _queue.size() < 16; });
+        _queue.push_back(std::move(batch));
+        _notEmpty.notify_one();
+    }
+    bool Pop(vector<void*>& batch) {
+        unique_lock<mutex> lock(_mtx);
+        _notEmpty.wait(lock, [this]() { return !_queue.empty() || _done; });
+        if (_queue.empty()) {
+            return false;
+        }
+        batch = std::move(_queue.front());
+        _queue.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+    void Close() {
+        lock_guard<mutex> lock(_mtx);
+        _done = true;
+        _notEmpty.notify_all();
+    }
+
+private:
+    mutex _mtx;
+    condition_variable _notEmpty;
+    condition_variable _notFull;
+    deque<vector<void*>> _queue;
+    bool _done = false;
+};
+
+#ifdef ENABLE_LOCK_PROFILE
+// 一组锁（所有CentralCache桶锁或所有传输缓存槽位锁）合计的加锁次数和持有时间
+static LockStats SumLocks(const LockStats (&locks)[NFREELIST]) {
+    LockStats sum;
+    for (const LockStats& s : locks) {
+        sum.acquisitions += s.acquisitions;
+        sum.holdNs += s.holdNs;
+    }
+    return sum;
+}
+#endif
+
+// 正确性：消费者释放前检查生产者写入的内容
+void TestProducerConsumer(size_t pairs, size_t size, size_t batches) {
+#ifdef ENABLE_LOCK_PROFILE
+    LockProfile profile0 = GetLockProfile();
+    LockStats central0 = SumLocks(profile0.central);
+    LockStats transfer0 = SumLocks(profile0.transfer);
+#endif
+    const size_t batchSize = 1000;
+    atomic<size_t> errors{0};
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    vector<BatchQueue> queues(pairs);
+    for (size_t p = 0; p < pairs; ++p) {
+        BatchQueue* q = &queues[p];
+        threads.emplace_back([q, size, batches]() {
+            for (size_t b = 0; b < batches; ++b) {
+                vector<void*> batch(batchSize);
+                for (auto& ptr : batch) {
+                    ptr = ConcurrentAlloc(size);
+                    *(size_t*)ptr = size;
+                }
+                q->Push(std::move(batch));
+            }
+            q->Close();
+        });
+        threads.emplace_back([q, size, &errors]() {
+            vector<void*> batch;
+            while (q->Pop(batch)) {
+                for (void* ptr : batch) {
+                    if (*(size_t*)ptr != size) {
+                        errors++;
+                    }
+                    ConcurrentFree(ptr, size);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = chrono::high_resolution_clock::now();
+    assert(errors.load() == 0);
+
+    size_t ops = pairs * batches * batchSize;
+    cout << "[" << MODE_NAME << "] " << pairs << "对生产者/消费者 " << size << "字节 "
+         << ops << "个对象: "
+         << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+#ifdef ENABLE_LOCK_PROFILE
+    LockProfile profile = GetLockProfile();
+    LockStats central = SumLocks(profile.central), transfer = SumLocks(profile.transfer);
+    uint64_t centralNs = central.holdNs - central0.holdNs;
+    uint64_t centralCnt = central.acquisitions - central0.acquisitions;
+    uint64_t transferNs = transfer.holdNs - transfer0.holdNs;
+    uint64_t transferCnt = transfer.acquisitions - transfer0.acquisitions;
+    cout << "    CentralCache锁: " << centralCnt << "次, 共持有 " << centralNs / 1000 << " us"
+         << ", 每个对象 " << (double)centralNs / ops << " ns" << endl;
+    cout << "    TransferCache锁: " << transferCnt << "次, 共持有 " << transferNs / 1000 << " us"
+         << ", 每个对象 " << (double)transferNs / ops << " ns" << endl;
+    cout << "    锁持有时间合计: " << (centralNs + transferNs) / 1000 << " us" << endl;
+#endif
+}
+
+int main() {
+    cout << "========== " << MODE_NAME << " ==========" << endl << endl;
+
+    TestProducerConsumer(1, 16, 2000);
+    TestProducerConsumer(1, 256, 2000);
+    TestProducerConsumer(4, 64, 500);
+    TestProducerConsumer(2, 4096, 50);
+
+    cout << "\n所有测试完成！" << endl;
+    return 0;
+}